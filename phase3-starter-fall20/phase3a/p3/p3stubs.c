@@ -33,11 +33,18 @@ int P3FrameUnmap(int frame) CHECKRETURN;
 
 int P3PagerInit(int pages, int frames, int pagers) {return P1_SUCCESS;}
 int P3PagerShutdown(void) {return P1_SUCCESS;}
+int P3ReclaimInit(int low, int high) {return P1_SUCCESS;}
 
 // Phase 3d
 
+int P3SwapDisks(int disks) {return P1_SUCCESS;}
 int P3SwapInit(int pages, int frames) {return P1_SUCCESS;}
 int P3SwapShutdown(void) {return P1_SUCCESS;}
 int P3SwapFreeAll(PID pid) {return P1_SUCCESS;}
+int P3SwapLockTable(PID pid) {return P1_SUCCESS;}
+int P3SwapUnlockTable(PID pid) {return P1_SUCCESS;}
 int P3SwapOut(int *frame) {return P1_SUCCESS;}
 int P3SwapIn(PID pid, int page, int frame) {return P1_SUCCESS;}
+int P3SwapReadAhead(int window) {return P1_SUCCESS;}
+int P3SwapCacheSize(int percent) {return P1_SUCCESS;}
+int P3SwapFastSize(int pages) {return P1_SUCCESS;}
@@ -16,8 +16,15 @@
 #include "phase3Int.h"
 
 static USLOSS_PTE   *pageTables[P1_MAXPROC];
+static int          *swapMaps[P1_MAXPROC]; // page -> swap slot, -1 if none
 static int	numPages = 0; // # of pages in a page table
 static int numFrames = 0; // # of frames in physical memory
+static int lowWater = 0;  // reclaim watermarks, see P3_VmWatermarks
+static int highWater = 0;
+static int readAhead = 0; // swap read-ahead window, see P3_VmReadAhead
+static int swapCache = 0; // compressed swap cache size, see P3_VmSwapCache
+static int swapDisks = 1 << P3_SWAP_DISK; // disk units that hold swap, see P3_VmSwapDisks
+static int fastSwap = 0;  // fast swap tier size, see P3_VmFastSwap
 
 P3_VmStats	P3_vmStats;
 
@@ -72,6 +79,7 @@ P3_VmInit(int unused, int pages, int frames, int pagers)
 
     for (int i = 0; i < P1_MAXPROC; i++) {
         pageTables[i] = NULL;
+        swapMaps[i] = NULL;
     }
 
     USLOSS_IntVec[USLOSS_MMU_INT] = P3PageFaultHandler;
@@ -94,22 +102,231 @@ P3_VmInit(int unused, int pages, int frames, int pagers)
         goto done;
     }
 
+    result = P3SwapDisks(swapDisks);
+    if (result != P1_SUCCESS) {
+        USLOSS_Console("P3SwapDisks failed: %d\n", result);
+        goto done;
+    }
+
     result = P3SwapInit(pages, frames);
     if (result != P1_SUCCESS) {
         USLOSS_Console("P3SwapInit failed: %d\n", result);
         goto done;
     }
 
+    result = P3SwapReadAhead(readAhead);
+    if (result != P1_SUCCESS) {
+        USLOSS_Console("P3SwapReadAhead failed: %d\n", result);
+        goto done;
+    }
+
+    result = P3SwapCacheSize(swapCache);
+    if (result != P1_SUCCESS) {
+        USLOSS_Console("P3SwapCacheSize failed: %d\n", result);
+        goto done;
+    }
+
+    result = P3SwapFastSize(fastSwap);
+    if (result != P1_SUCCESS) {
+        USLOSS_Console("P3SwapFastSize failed: %d\n", result);
+        goto done;
+    }
+
     result = P3PagerInit(pages, frames, pagers);
     if (result != P1_SUCCESS) {
         USLOSS_Console("P3PagerInit failed: %d\n", result);
         goto done;
     }
 
+    result = P3ReclaimInit(lowWater, highWater);
+    if (result != P1_SUCCESS) {
+        USLOSS_Console("P3ReclaimInit failed: %d\n", result);
+        goto done;
+    }
+
     result = P1_SUCCESS;
 done:
     return result;
 }
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3_VmWatermarks --
+ *
+ *	Configures the reclaim daemon. It is woken when the number of
+ *	free frames drops below low and evicts pages in the background
+ *	until high frames are free. Must be called before P3_VmInit.
+ *	The default of 0 for both leaves the daemon off, so that pages
+ *	are only evicted when a fault finds no free frame.
+ *
+ * Parameters:
+ *      low: low watermark, in frames
+ *      high: high watermark, in frames
+ *
+ * Results:
+ *      P3_ALREADY_INITIALIZED: P3_VmInit has already been called
+ *      P3_INVALID_WATERMARKS: low is negative or greater than high
+ *      P1_SUCCESS: success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3_VmWatermarks(int low, int high)
+{
+    CheckMode();
+    if (initialized) {
+        return P3_ALREADY_INITIALIZED;
+    }
+    if ((low < 0) || (high < low)) {
+        return P3_INVALID_WATERMARKS;
+    }
+    lowWater = low;
+    highWater = high;
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3_VmReadAhead --
+ *
+ *	Configures swap read-ahead. When a page is read in from swap,
+ *	up to window of the process's following pages that sit in the
+ *	following swap slots are read in the same disk request into
+ *	spare free frames, and mapped without being marked referenced.
+ *	Must be called before P3_VmInit. The default of 0 reads in
+ *	only the faulting page.
+ *
+ * Parameters:
+ *      window: # of pages to read ahead, at most P3_MAX_READ_AHEAD
+ *
+ * Results:
+ *      P3_ALREADY_INITIALIZED: P3_VmInit has already been called
+ *      P3_INVALID_READ_AHEAD: window is negative or too big
+ *      P1_SUCCESS: success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3_VmReadAhead(int window)
+{
+    CheckMode();
+    if (initialized) {
+        return P3_ALREADY_INITIALIZED;
+    }
+    if ((window < 0) || (window > P3_MAX_READ_AHEAD)) {
+        return P3_INVALID_READ_AHEAD;
+    }
+    readAhead = window;
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3_VmSwapCache --
+ *
+ *	Configures the compressed swap cache. Dirty pages that are
+ *	evicted are compressed and kept in memory, and only go to the
+ *	swap disk when they don't fit. Must be called before P3_VmInit.
+ *	The default of 0 turns the cache off.
+ *
+ * Parameters:
+ *      percent: size of the cache, as a percentage of physical memory
+ *
+ * Results:
+ *      P3_ALREADY_INITIALIZED: P3_VmInit has already been called
+ *      P3_INVALID_CACHE_SIZE: percent is not between 0 and 100
+ *      P1_SUCCESS: success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3_VmSwapCache(int percent)
+{
+    CheckMode();
+    if (initialized) {
+        return P3_ALREADY_INITIALIZED;
+    }
+    if ((percent < 0) || (percent > 100)) {
+        return P3_INVALID_CACHE_SIZE;
+    }
+    swapCache = percent;
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3_VmSwapDisks --
+ *
+ *	Configures the disk units that hold swap space. New swap slots
+ *	are placed on the units in turn, so pagers can page in and out
+ *	in parallel on different units, while a process's consecutive
+ *	pages stay together on one unit for read-ahead. Must be called
+ *	before P3_VmInit. The default is P3_SWAP_DISK alone.
+ *
+ * Parameters:
+ *      disks: bit i set means unit i holds swap
+ *
+ * Results:
+ *      P3_ALREADY_INITIALIZED: P3_VmInit has already been called
+ *      P3_INVALID_SWAP_DISKS: disks is empty or names a unit that
+ *                             doesn't exist
+ *      P1_SUCCESS: success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3_VmSwapDisks(int disks)
+{
+    CheckMode();
+    if (initialized) {
+        return P3_ALREADY_INITIALIZED;
+    }
+    if ((disks <= 0) || (disks >= (1 << USLOSS_DISK_UNITS))) {
+        return P3_INVALID_SWAP_DISKS;
+    }
+    swapDisks = disks;
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3_VmFastSwap --
+ *
+ *	Configures the fast swap tier, a RAM-backed area in front of
+ *	the swap disks. Pages that have been read back in from swap
+ *	HOT times are written to it when they are evicted, or copied up
+ *	to it when they are read from disk, and the least recently used
+ *	pages are demoted to disk when it is full. Must be called before
+ *	P3_VmInit. The default of 0 turns it off.
+ *
+ * Parameters:
+ *      pages: size of the tier, in pages
+ *
+ * Results:
+ *      P3_ALREADY_INITIALIZED: P3_VmInit has already been called
+ *      P3_INVALID_FAST_SIZE: pages is negative
+ *      P1_SUCCESS: success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3_VmFastSwap(int pages)
+{
+    CheckMode();
+    if (initialized) {
+        return P3_ALREADY_INITIALIZED;
+    }
+    if (pages < 0) {
+        return P3_INVALID_FAST_SIZE;
+    }
+    fastSwap = pages;
+    return P1_SUCCESS;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -163,7 +380,8 @@ P3_VmShutdown(void)
  *
  * P3_AllocatePageTable --
  *
- *	Allocates a page table for the new process.
+ *	Allocates a page table for the new process, along with the
+ *	map from its pages to their swap slots.
  *
  * Parameters:
  *      pid : pid of new process
@@ -192,6 +410,13 @@ P3_AllocatePageTable(int pid)
             pageTable = PageTableAllocateIdentity(numPages);
         }
         pageTables[pid] = pageTable;
+        if (pageTable != NULL) {
+            swapMaps[pid] = malloc(sizeof(int) * numPages);
+            assert(swapMaps[pid] != NULL);
+            for (int i = 0; i < numPages; i++) {
+                swapMaps[pid][i] = -1;
+            }
+        }
     }
 done:
     return pageTable;
@@ -222,6 +447,7 @@ void
 P3_FreePageTable(int pid)
 {
     int rc;
+    int result;
 
     CheckMode();
     if ((pid < 0) || (pid >= P1_MAXPROC)) {
@@ -230,21 +456,32 @@ P3_FreePageTable(int pid)
     }
     if ((initialized) && (pageTables[pid] != NULL)) {
 
-        rc = P3SwapFreeAll(pid);
-        if (rc != P1_SUCCESS) {
-            USLOSS_Console("P3_FreePageTable: P3SwapFreeAll(%d) failed: %d\n", pid, rc);
+        // the page table is locked against the pagers while it changes. The
+        // frames go first, so that no pager gives the process's pages swap
+        // slots after P3SwapFreeAll has freed them.
+        rc = P3SwapLockTable(pid);
+        assert(rc == P1_SUCCESS);
+        result = P3FrameFreeAll(pid);
+        rc = P3SwapUnlockTable(pid);
+        assert(rc == P1_SUCCESS);
+        if (result != P1_SUCCESS) {
+            USLOSS_Console("P3_FreePageTable: P3FrameFreeAll(%d) failed: %d\n", pid, result);
             goto done;
         }
 
-        rc = P3FrameFreeAll(pid);
+        rc = P3SwapFreeAll(pid);
         if (rc != P1_SUCCESS) {
-            USLOSS_Console("P3_FreePageTable: P3FrameFreeAll(%d) failed: %d\n", pid, rc);
+            USLOSS_Console("P3_FreePageTable: P3SwapFreeAll(%d) failed: %d\n", pid, rc);
             goto done;
         }
 
-        rc = PageTableFree(pid);
-        if (rc != P1_SUCCESS) {
-            USLOSS_Console("P3_FreePageTable: PageTableFree(%d) failed: %d\n", pid, rc);
+        rc = P3SwapLockTable(pid);
+        assert(rc == P1_SUCCESS);
+        result = PageTableFree(pid);
+        rc = P3SwapUnlockTable(pid);
+        assert(rc == P1_SUCCESS);
+        if (result != P1_SUCCESS) {
+            USLOSS_Console("P3_FreePageTable: PageTableFree(%d) failed: %d\n", pid, result);
             goto done;
         }
     }
@@ -264,6 +501,18 @@ P3PageTableGet(PID pid, USLOSS_PTE **table)
     return result;
 }
 
+int
+P3SwapMapGet(PID pid, int **map)
+{
+    int result = P1_SUCCESS;
+    if ((pid < 0) || (pid >= P1_MAXPROC)) {
+        result = P1_INVALID_PID;
+    } else {
+        *map = swapMaps[pid];
+    }
+    return result;
+}
+
 int
 P3PageTableSet(PID pid, USLOSS_PTE *table)
 {
@@ -343,6 +592,8 @@ PageTableFree(PID pid)
 	}
 	    free(pageTables[pid] );
 	    pageTables[pid] = NULL;
+	    free(swapMaps[pid]);
+	    swapMaps[pid] = NULL;
 	}
 
     return P1_SUCCESS;
@@ -393,6 +644,38 @@ P3_PrintStats(P3_VmStats *stats)
     USLOSS_Console("\tnew:\t\t%d\n", stats->new);
     USLOSS_Console("\tpageIns:\t%d\n", stats->pageIns);
     USLOSS_Console("\tpageOuts:\t%d\n", stats->pageOuts);
+    USLOSS_Console("\tcleanDrops:\t%d\n", stats->cleanDrops);
+    USLOSS_Console("\tzeroPages:\t%d\n", stats->zeroPages);
     USLOSS_Console("\treplaced:\t%d\n", stats->replaced);
+    USLOSS_Console("\tmaxQueue:\t%d\n", stats->maxQueue);
+    USLOSS_Console("\twakeups:\t%d\n", stats->wakeups);
+    if (stats->wakeups > 0) {
+        USLOSS_Console("\tfaults/wakeup:\t%.2f\n", (double) stats->faults / stats->wakeups);
+    }
+    USLOSS_Console("\tspawned:\t%d\n", stats->spawned);
+    USLOSS_Console("\tretired:\t%d\n", stats->retired);
+    USLOSS_Console("\tstolen:\t\t%d\n", stats->stolen);
+    USLOSS_Console("\treclaimed:\t%d\n", stats->reclaimed);
+    USLOSS_Console("\tprefetched:\t%d\n", stats->prefetched);
+    USLOSS_Console("\tdiskOps:\t%d\n", stats->diskOps);
+    USLOSS_Console("\tseekDistance:\t%d\n", stats->seekDistance);
+    if (stats->diskOps > 0) {
+        USLOSS_Console("\ttracks/op:\t%.2f\n", (double) stats->seekDistance / stats->diskOps);
+    }
+    USLOSS_Console("\tcached:\t\t%d\n", stats->cached);
+    USLOSS_Console("\tcacheHits:\t%d\n", stats->cacheHits);
+    USLOSS_Console("\tdedupHits:\t%d\n", stats->dedupHits);
+    USLOSS_Console("\tshared:\t\t%d (%d bytes saved)\n", stats->shared,
+        stats->shared * USLOSS_MmuPageSize());
+    USLOSS_Console("\tioWaits:\t%d\n", stats->ioWaits);
+    USLOSS_Console("\tfastIns:\t%d\n", stats->fastIns);
+    USLOSS_Console("\tfastOuts:\t%d\n", stats->fastOuts);
+    USLOSS_Console("\tslowIns:\t%d\n", stats->slowIns);
+    USLOSS_Console("\tpromoted:\t%d\n", stats->promoted);
+    USLOSS_Console("\tdemoted:\t%d\n", stats->demoted);
+    if (stats->pageIns > 0) {
+        USLOSS_Console("\tfast hit rate:\t%.2f\n", (double) stats->fastIns / stats->pageIns);
+        USLOSS_Console("\tslow hit rate:\t%.2f\n", (double) stats->slowIns / stats->pageIns);
+    }
 }
 
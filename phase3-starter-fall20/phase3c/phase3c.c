@@ -34,8 +34,36 @@ void debug3(char *fmt, ...)
 
 
 
-int *freeFrames;
+int *freeFrames;     // TRUE if the frame is in the free pool
 int *usedMap;
+static int *freeStack;  // free pool, stack of frame numbers
+static int freeTop;     // # of frames in the free pool
+static P3FrameInfo *frameInfo; // frame -> owner pid/page/swap slot
+
+// # of pages at the top of each pager's VM region reserved for mapping frames
+#define SCRATCH_PAGES 2
+
+// max # of queued faults a pager takes each time it wakes up
+#define PAGER_BATCH 4
+
+// the pager pool never shrinks below PAGERS_MIN, and grows by one pager (up to
+// the number passed to P3PagerInit) when a pager leaves PAGER_GROW or more
+// faults in the queue after taking its batch
+#define PAGERS_MIN 1
+#define PAGER_GROW PAGER_BATCH
+
+// an extra pager retires once the pool has been idle this long (us)
+#define PAGER_IDLE_TIME 500000
+
+// tag for pagers forked by the pool, so that they are joined only by the pool
+#define PAGER_TAG 1
+
+// # of process priorities, 1 (highest) to 6
+#define FAULT_LEVELS 6
+
+// a queued fault is served ahead of higher priorities once this many faults
+// have been dequeued since it arrived
+#define FAULT_AGE 8
 
 typedef struct Fault {
     PID pid;  
@@ -44,33 +72,80 @@ typedef struct Fault {
     SID wait;      
     int kill;       
     int stat;           
+    int priority;   // priority of the faulting process
+    int arrived;    // value of the queue's "served" when the fault was queued
 } Fault;
 
-struct Node {
-    Fault *fault;          
-    struct Node *next;   
-};
+// FIFO of faults from processes with the same priority
+typedef struct FaultRing {
+    Fault *faults[P1_MAXPROC];
+    int head;       // index of the oldest fault
+    int count;      // # of faults in the ring
+} FaultRing;
+
+// a pager's queue of faults, one ring per priority. A process has at most one
+// outstanding fault so a ring never holds more than P1_MAXPROC.
+typedef struct FaultQueue {
+    FaultRing rings[FAULT_LEVELS];
+    int count;      // # of faults in the queue
+    int served;     // # of faults dequeued so far
+} FaultQueue;
 
 typedef struct PagerInfo {
     SID sid;            
     PID pid;        
+    int scratch[SCRATCH_PAGES]; // frame mapped at each scratch page, -1 if none
+    int active;     // TRUE if a pager is running in this slot
+    SID wake;       // pager sleeps on this when it has no faults
+    int idle;       // TRUE if asleep and not yet woken
+    int retire;     // TRUE if woken by PagerClock to retire
+    FaultQueue queue;   // faults from the PIDs that hash to this pager
 } PagerInfo;
 
 static int init = FALSE;
 static int initPager = FALSE;
-static struct Node *faultQueue = NULL;
+static int queueCount = 0;  // # of faults in all the pagers' queues
 static int shutDown = FALSE;
 static PagerInfo pagerTracker[P3_MAX_PAGERS];
 static int totalPagers;
-static SID pagerSem;
+static SID faultSems[P1_MAXPROC]; // faulting process waits on the one for its PID
+static int activePagers = 0;    // # of pagers running
+static int unreaped = 0;    // # of retired pagers that haven't been joined
+static int lastBusy = 0;    // time a pager last took a batch of faults
+static void (*clockHandler)(int type, void *arg);  // phase 2 clock handler
+static PagerInfo reclaimer;     // reclaim daemon, maps frames like a pager
+static int reclaiming = FALSE;  // TRUE if the reclaim daemon has been woken
+static int lowWater = 0;    // wake the reclaim daemon below this many free frames
+static int highWater = 0;   // the reclaim daemon frees frames up to this many
+static char *vmRegion;      // start of the VM region
+static int scratchBase;     // first scratch page
+static int numScratch;      // # of scratch pages per pager
+
 
+void enqueue(FaultQueue *q, Fault *f);
 
-void enqueue(Fault *f);
+void dequeue(FaultQueue *q, Fault **retVal);
 
-void dequeue(Fault **retVal);
+static FaultQueue *Busiest(void);
 
 static int Pager(void *arg);
 
+static int FrameAlloc(void);
+
+static void FrameRelease(int frame);
+
+static PagerInfo *FindPager(PID pid);
+
+static void ServeFault(Fault *fault, int frame);
+
+static void SpawnPager(int slot, int tag);
+
+static void PagerClock(int type, void *arg);
+
+static int Reclaimer(void *arg);
+
+static void CheckReclaim(void);
+
 
 /*
  *----------------------------------------------------------------------
@@ -101,12 +176,19 @@ P3FrameInit(int pages, int frames)
     // initialize the frame data structures, e.g. the pool of free frames
     // set P3_vmStats.freeFrames
 
-    P3_vmStats.freeFrames = frames;
+    int regionPages;
+    vmRegion = USLOSS_MmuRegion(&regionPages);
+    P3_vmStats.freeFrames = 0;
     freeFrames = malloc(sizeof(int) * frames);
     usedMap = malloc(sizeof(int) * frames);
-    for (int i = 0; i < P3_vmStats.frames; i++){
-        freeFrames[i] = TRUE;
+    freeStack = malloc(sizeof(int) * frames);
+    freeTop = 0;
+    frameInfo = malloc(sizeof(P3FrameInfo) * frames);
+    // push in reverse so that frame 0 is handed out first
+    for (int i = frames - 1; i >= 0; i--){
+        freeFrames[i] = FALSE;
         usedMap[i] = FALSE;
+        FrameRelease(i);
     }
 
     init = TRUE;
@@ -138,6 +220,8 @@ P3FrameShutdown(void)
     int result = P1_SUCCESS;
     free(freeFrames);
     free(usedMap);
+    free(freeStack);
+    free(frameInfo);
 
     // clean things up
 
@@ -149,7 +233,10 @@ P3FrameShutdown(void)
  *
  * P3FrameFreeAll --
  *
- *  Frees all frames used by a process
+ *  Frees all frames used by a process. Called with the process's page
+ *  table locked (P3SwapLockTable). A frame that a pager has marked busy
+ *  is left to the pager: its descriptor no longer names the process,
+ *  and the pager frees or reuses it when it sees that.
  *
  * Results:
  *   P3_NOT_INITIALIZED:    P3FrameInit has not been called
@@ -181,9 +268,18 @@ P3FrameFreeAll(int pid)
     // free all frames in use by the process (P3PageTableGet)
     for (int i = 0; i < P3_vmStats.pages; i++){
         if(pageTable[i].incore){
+            int frame = pageTable[i].frame;
             pageTable[i].incore = 0;
-            freeFrames[pageTable[i].frame] = TRUE;
-            P3_vmStats.freeFrames++;
+            if (frameInfo[frame].pid != pid) {
+                continue;
+            }
+            if (frameInfo[frame].busy) {
+                frameInfo[frame].pid = -1;
+                frameInfo[frame].page = -1;
+                frameInfo[frame].slot = -1;
+            } else {
+                FrameRelease(frame);
+            }
         }
     }
 
@@ -227,23 +323,30 @@ P3FrameMap(int frame, void **ptr)
     int rc;
     rc = P3PageTableGet(P1_GetPid(), &pageTable);
     assert(rc == P1_SUCCESS);
-    // find an unused page
-
+    // find an unused page, pagers use their scratch pages
+    PagerInfo *pager = FindPager(P1_GetPid());
     int op = -1;
-    for (int i = 0; i < P3_vmStats.pages; i++) {
-        if (!pageTable[i].incore) {
-            op = i;
-            continue;
+    if (pager != NULL) {
+        for (int i = 0; i < numScratch; i++) {
+            if (pager->scratch[i] == -1) {
+                pager->scratch[i] = frame;
+                op = scratchBase + i;
+                break;
+            }
+        }
+    } else {
+        for (int i = 0; i < P3_vmStats.pages; i++) {
+            if (!pageTable[i].incore) {
+                op = i;
+                break;
+            }
         }
     }
 
     if(op==-1){
         return P3_OUT_OF_PAGES;
     }
-    int pages;
-    char *addr = USLOSS_MmuRegion(&pages);
-    addr += op * USLOSS_MmuPageSize();
-    *ptr = addr;
+    *ptr = vmRegion + op * USLOSS_MmuPageSize();
     // update the page's PTE to map the page to the frame
     pageTable[op].frame = frame;
     pageTable[op].incore = 1;
@@ -251,7 +354,10 @@ P3FrameMap(int frame, void **ptr)
     pageTable[op].write = 1;
     usedMap[frame] = TRUE;
 
-    // update the page table in the MMU (USLOSS_MmuSetPageTable)
+    // update the page table in the MMU (USLOSS_MmuSetPageTable). This is
+    // needed for pagers too: the MMU only rereads PTEs when a table is set,
+    // and a pager may have just loaded another process's table to change
+    // its mappings, so its own table has to be put back before the access
     rc = USLOSS_MmuSetPageTable(pageTable);
     assert(rc == P1_SUCCESS);
 
@@ -291,10 +397,22 @@ P3FrameUnmap(int frame)
     int pt = P3PageTableGet(P1_GetPid(), &pageTable);
     assert(pt == P1_SUCCESS);
     // verify that the process mapped the frame
+    PagerInfo *pager = FindPager(P1_GetPid());
     int map = -1;
-    for (int i = 0; i < P3_vmStats.pages; i++) {
-        if (pageTable[i].incore && pageTable[i].frame == frame) {
-            map = i;
+    if (pager != NULL) {
+        for (int i = 0; i < numScratch; i++) {
+            if (pager->scratch[i] == frame) {
+                pager->scratch[i] = -1;
+                map = scratchBase + i;
+                break;
+            }
+        }
+    } else {
+        for (int i = 0; i < P3_vmStats.pages; i++) {
+            if (pageTable[i].incore && pageTable[i].frame == frame) {
+                map = i;
+                break;
+            }
         }
     }
     if(map == -1 || !usedMap[frame]){
@@ -303,12 +421,82 @@ P3FrameUnmap(int frame)
     // update page's PTE to remove the mapping
     pageTable[map].incore = 0;
     usedMap[frame] = FALSE;
-    // update the page table in the MMU (USLOSS_MmuSetPageTable)
-    pt = USLOSS_MmuSetPageTable(pageTable);
-    assert(pt == P1_SUCCESS);
+    // pagers never touch a scratch page after unmapping it, so the MMU
+    // can keep the stale entry until the next P3FrameMap reloads the table
+    if (pager == NULL) {
+        pt = USLOSS_MmuSetPageTable(pageTable);
+        assert(pt == P1_SUCCESS);
+    }
     return result;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameInfoGet --
+ *
+ *  Returns the descriptor for a frame: the process and page that
+ *  own it and the swap slot that backs it.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3FrameInit has not been called
+ *   P1_INVALID_FRAME       the frame number is invalid
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3FrameInfoGet(int frame, P3FrameInfo **info)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0) {
+        int pid; Sys_GetPID(&pid); USLOSS_Console("Process %d called %s from user mode.\n", pid, __FUNCTION__); 
+        USLOSS_IllegalInstruction(); 
+        }
+    if(!init){
+        return P3_NOT_INITIALIZED;
+    }
+    if(frame < 0 || frame >= P3_vmStats.frames){
+        return P3_INVALID_FRAME;
+    }
+    *info = &frameInfo[frame];
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameSpare --
+ *
+ *  Takes a frame from the free pool for swap read-ahead. A frame is
+ *  only handed out if the pool stays above the reclaim daemon's low
+ *  watermark, so read-ahead never causes reclaim or replacement. With
+ *  the daemon off the pool is empty once memory is full, and there is
+ *  no read-ahead from then on. The frame is busy until its page is
+ *  mapped. *frame is set to -1 if there is no spare frame.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3FrameInit has not been called
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3FrameSpare(int *frame)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0) {
+        int pid; Sys_GetPID(&pid); USLOSS_Console("Process %d called %s from user mode.\n", pid, __FUNCTION__); 
+        USLOSS_IllegalInstruction(); 
+        }
+    if(!init){
+        return P3_NOT_INITIALIZED;
+    }
+    *frame = -1;
+    if (P3_vmStats.freeFrames > lowWater) {
+        *frame = FrameAlloc();
+    }
+    return P1_SUCCESS;
+}
+
 
 
 /*
@@ -329,7 +517,6 @@ FaultHandler(int type, void *arg)
         USLOSS_IllegalInstruction(); 
         }
     Fault   fault;
-    char semName[P1_MAXNAME+1];
 
     fault.offset = (int) arg;
     // fill in other fields in fault
@@ -337,23 +524,58 @@ FaultHandler(int type, void *arg)
     fault.cause = USLOSS_MmuGetCause();
     fault.kill = FALSE;
     fault.stat = 0;
-
-    snprintf(semName, sizeof(semName), "%d", fault.pid);
+    fault.wait = faultSems[fault.pid];
     int rc;
-    rc = P1_SemCreate(semName, 0, &fault.wait);
+    P3_vmStats.faults++;
+
+    P1_ProcInfo info;
+    rc = P1_GetProcInfo(fault.pid, &info);
     assert(rc == P1_SUCCESS);
+    fault.priority = info.priority;
 
     // add to queue of pending faults
-    enqueue(&fault);
-    // let pagers know there is a pending fault
-    rc = P1_V(pagerSem);
-    assert(rc == P1_SUCCESS);
+    int psr = USLOSS_PsrGet();
+    rc = USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+    assert(rc == USLOSS_DEV_OK);
+    // faults for a slot with no pager running are spread by PID over the
+    // pagers that are running, a retired pager's queue would only be drained
+    // by stealing
+    PagerInfo *owner = &pagerTracker[fault.pid % totalPagers];
+    if (!owner->active) {
+        int k = fault.pid % activePagers;
+        for (int i = 0; i < totalPagers; i++) {
+            if (pagerTracker[i].active && k-- == 0) {
+                owner = &pagerTracker[i];
+                break;
+            }
+        }
+    }
+    enqueue(&owner->queue, &fault);
+    // wake the pager the PID hashes to if it is asleep, otherwise any sleeping
+    // pager, which will steal the fault. Busy pagers will find it when they
+    // finish their current batch.
+    PagerInfo *wake = NULL;
+    if (owner->active && owner->idle) {
+        wake = owner;
+    }
+    for (int i = 0; wake == NULL && i < totalPagers; i++) {
+        if (pagerTracker[i].active && pagerTracker[i].idle) {
+            wake = &pagerTracker[i];
+        }
+    }
+    if (wake != NULL) {
+        wake->idle = FALSE;
+    }
+    rc = USLOSS_PsrSet(psr);
+    assert(rc == USLOSS_DEV_OK);
+    if (wake != NULL) {
+        rc = P1_V(wake->wake);
+        assert(rc == P1_SUCCESS);
+    }
     // wait for fault to be handled
     rc = P1_P(fault.wait);
     assert(rc == P1_SUCCESS);
     // kill off faulting process so skeleton code doesn't hang
-    rc = P1_SemFree(fault.wait);
-    assert(rc == P1_SUCCESS);
     if(fault.kill){
         P1_Quit(fault.stat);
     }
@@ -387,30 +609,39 @@ P3PagerInit(int pages, int frames, int pagers)
     int     result = P1_SUCCESS;
 
     USLOSS_IntVec[USLOSS_MMU_INT] = FaultHandler;
+    reclaimer.active = FALSE;
 
     // initialize the pager data structures
     totalPagers = pagers;
     char semName[P1_MAXNAME + 1];
     int rc;
+    // reserve the scratch pages at the top of each pager's VM region
+    numScratch = pages < SCRATCH_PAGES ? pages : SCRATCH_PAGES;
+    scratchBase = pages - numScratch;
     for (int i = 0; i < pagers; i++){
-        
+        pagerTracker[i].pid = -1;
+        pagerTracker[i].active = FALSE;
         snprintf(semName, sizeof(semName), "%d", i);
         rc = P1_SemCreate(semName, 0, &pagerTracker[i].sid);
         assert(rc == P1_SUCCESS);
+        snprintf(semName, sizeof(semName), "wake%d", i);
+        rc = P1_SemCreate(semName, 0, &pagerTracker[i].wake);
+        assert(rc == P1_SUCCESS);
     }
 
-    rc = P1_SemCreate("Sem", 0, &pagerSem);
-    assert(rc == P1_SUCCESS);
-
-    // fork off the pagers and wait for them to start running
-    char pagerName[P1_MAXNAME + 1];
-    for (int i = 0; i<pagers;i++){
-        snprintf(pagerName, sizeof(pagerName), "%d", i);
-        rc = P1_Fork(pagerName, Pager, (void *) i, USLOSS_MIN_STACK, P3_PAGER_PRIORITY, 0, &pagerTracker[i].pid);
-        assert(rc == P1_SUCCESS);
-        rc = P1_P(pagerTracker[i].sid);
+    // one wait semaphore per PID, reused by every fault the process takes
+    for (int i = 0; i < P1_MAXPROC; i++){
+        snprintf(semName, sizeof(semName), "fault%d", i);
+        rc = P1_SemCreate(semName, 0, &faultSems[i]);
         assert(rc == P1_SUCCESS);
     }
+
+    // fork off the minimum pool, the rest of the pagers are forked on demand
+    for (int i = 0; i < pagers && i < PAGERS_MIN; i++){
+        SpawnPager(i, 0);
+    }
+    clockHandler = USLOSS_IntVec[USLOSS_CLOCK_INT];
+    USLOSS_IntVec[USLOSS_CLOCK_INT] = PagerClock;
     initPager = TRUE;
     return result;
 }
@@ -442,23 +673,87 @@ P3PagerShutdown(void)
     int result = P1_SUCCESS;
     int rc;
     shutDown = TRUE;
-    // cause the pagers to quit
+    USLOSS_IntVec[USLOSS_CLOCK_INT] = clockHandler;
+    // cause the pagers and the reclaim daemon to quit
     for (int i = 0; i<totalPagers; i++){
-        rc = P1_V(pagerSem);
+        rc = P1_V(pagerTracker[i].wake);
+        assert(rc == P1_SUCCESS);
+    }
+    if (reclaimer.active) {
+        rc = P1_V(reclaimer.wake);
         assert(rc == P1_SUCCESS);
+        rc = P1_SemFree(reclaimer.sid);
+        assert(rc == P1_SUCCESS);
+        rc = P1_SemFree(reclaimer.wake);
+        assert(rc == P1_SUCCESS);
+        reclaimer.active = FALSE;
     }
     // clean up the pager data structures
     for (int i = 0; i<totalPagers;i++){
         rc = P1_SemFree(pagerTracker[i].sid);
+        assert(rc == P1_SUCCESS);
+        rc = P1_SemFree(pagerTracker[i].wake);
+        assert(rc == P1_SUCCESS);
         pagerTracker[i].pid = -1;
+    }
+    for (int i = 0; i < P1_MAXPROC; i++){
+        rc = P1_SemFree(faultSems[i]);
         assert(rc == P1_SUCCESS);
     }
-    rc = P1_SemFree(pagerSem);
-    assert(rc == P1_SUCCESS);
 
     return result;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3ReclaimInit --
+ *
+ *  Starts the reclaim daemon, which keeps free frames between the low
+ *  and high watermarks by evicting pages in the background. The daemon
+ *  isn't started if low is 0.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3PagerInit has not been called
+ *   P3_INVALID_WATERMARKS:  the watermarks are invalid
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3ReclaimInit(int low, int high)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0) {
+        int pid; Sys_GetPID(&pid); USLOSS_Console("Process %d called %s from user mode.\n", pid, __FUNCTION__); 
+        USLOSS_IllegalInstruction(); 
+        }
+    if(!initPager){
+        return P3_NOT_INITIALIZED;
+    }
+    if(low < 0 || high < low || high > P3_vmStats.frames){
+        return P3_INVALID_WATERMARKS;
+    }
+    lowWater = low;
+    highWater = high;
+    if (low == 0) {
+        return P1_SUCCESS;
+    }
+    int rc;
+    rc = P1_SemCreate("reclaim", 0, &reclaimer.sid);
+    assert(rc == P1_SUCCESS);
+    rc = P1_SemCreate("reclaimWake", 0, &reclaimer.wake);
+    assert(rc == P1_SUCCESS);
+    for (int j = 0; j < SCRATCH_PAGES; j++) {
+        reclaimer.scratch[j] = -1;
+    }
+    reclaimer.active = TRUE;
+    rc = P1_Fork("Reclaimer", Reclaimer, NULL, USLOSS_MIN_STACK, P3_PAGER_PRIORITY, 0, &reclaimer.pid);
+    assert(rc == P1_SUCCESS);
+    rc = P1_P(reclaimer.sid);
+    assert(rc == P1_SUCCESS);
+    return P1_SUCCESS;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -476,101 +771,431 @@ Pager(void *arg)
         int pid; Sys_GetPID(&pid); USLOSS_Console("Process %d called %s from user mode.\n", pid, __FUNCTION__); 
         USLOSS_IllegalInstruction(); 
         }
-    Fault *fault;
-    int pageInx;
-    void *page;
-    int frame;
-    USLOSS_PTE *pageTable;
+    Fault *batch[PAGER_BATCH];
+    int frames[PAGER_BATCH];
+    int victims[PAGER_BATCH];
     int pagerid;
     pagerid = (int) arg;
 
     int rc;
+    pagerTracker[pagerid].pid = P1_GetPid();
     rc = P1_V(pagerTracker[pagerid].sid);
     assert(rc == P1_SUCCESS);
 
+    PagerInfo *me = &pagerTracker[pagerid];
     while(!shutDown){
-        rc = P1_P(pagerSem);
-        assert(rc == P1_SUCCESS);
-        dequeue(&fault);
+        // take a batch of faults from our own queue, or steal them from the
+        // busiest queue, or go to sleep if there are none. Interrupts are off
+        // so that a fault can't be queued between the check and the sleep.
+        int n = 0;
+        int psr = USLOSS_PsrGet();
+        rc = USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+        assert(rc == USLOSS_DEV_OK);
+        FaultQueue *q = &me->queue;
+        if (q->count == 0) {
+            q = Busiest();
+        }
+        while (q != NULL && n < PAGER_BATCH) {
+            dequeue(q, &batch[n]);
+            if (batch[n] == NULL) {
+                break;
+            }
+            n++;
+        }
+        if (q != &me->queue) {
+            P3_vmStats.stolen += n;
+        }
+        if (n == 0 && me->retire && !shutDown) {
+            // woken by PagerClock with nothing to do, leave the pool
+            pagerTracker[pagerid].active = FALSE;
+            pagerTracker[pagerid].pid = -1;
+            activePagers--;
+            unreaped++;
+            P3_vmStats.retired++;
+            rc = USLOSS_PsrSet(psr);
+            assert(rc == USLOSS_DEV_OK);
+            rc = P3SwapBufFree(P1_GetPid());
+            assert(rc == P1_SUCCESS);
+            return 0;
+        }
+        me->retire = FALSE;
+        if (n == 0) {
+            me->idle = TRUE;
+        }
+        rc = USLOSS_PsrSet(psr);
+        assert(rc == USLOSS_DEV_OK);
+        if (n == 0) {
+            rc = P1_P(me->wake);
+            assert(rc == P1_SUCCESS);
+            continue;
+        }
+        P3_vmStats.wakeups++;
+        rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &lastBusy);
+        assert(rc == USLOSS_DEV_OK);
 
-        if(fault !=NULL){
-            if((*fault).cause == USLOSS_MMU_ACCESS){
-                (*fault).kill = TRUE;
-                (*fault).stat = USLOSS_MMU_ACCESS;
-                rc = P1_V((*fault).wait);
+        // the permanent pagers reap retired pagers and grow the pool
+        if (pagerid < PAGERS_MIN) {
+            while (unreaped > 0) {
+                int pid, status;
+                rc = P1_Join(PAGER_TAG, &pid, &status);
                 assert(rc == P1_SUCCESS);
-                //break;
-                continue;
+                unreaped--;
             }
-        frame = -1;
-        for (int i = 0; i < P3_vmStats.frames && frame == -1; i++) {
-            if (freeFrames[i]) {
-                frame = i;
+            if (queueCount >= PAGER_GROW && activePagers < totalPagers) {
+                for (int i = PAGERS_MIN; i < totalPagers; i++) {
+                    if (!pagerTracker[i].active) {
+                        SpawnPager(i, PAGER_TAG);
+                        P3_vmStats.spawned++;
+                        break;
+                    }
                 }
             }
-        if(frame==-1){
-            rc = P3SwapOut(&frame);
-            P3_vmStats.freeFrames++;
         }
-        pageInx = (*fault).offset / USLOSS_MmuPageSize();
-        rc = P3SwapIn((*fault).pid, pageInx, frame);
 
-        if (rc == P3_EMPTY_PAGE){
-            rc = P3FrameMap(frame, &page);
-            assert(rc == P1_SUCCESS);
-            memset(page, 0, USLOSS_MmuPageSize());
-            rc = P3FrameUnmap(frame);
+        // give each fault a free frame if there is one
+        int need = 0;
+        for (int i = 0; i < n; i++) {
+            if((*batch[i]).cause == USLOSS_MMU_ACCESS){
+                (*batch[i]).kill = TRUE;
+                (*batch[i]).stat = USLOSS_MMU_ACCESS;
+                rc = P1_V((*batch[i]).wait);
+                assert(rc == P1_SUCCESS);
+                batch[i] = NULL;
+                continue;
+            }
+            frames[i] = FrameAlloc();
+            if (frames[i] == -1) {
+                need++;
+            }
+        }
+        CheckReclaim();
+        // choose victims for the rest in one clock sweep
+        int got = 0;
+        if (need > 0) {
+            rc = P3SwapOutBatch(need, victims, &got);
             assert(rc == P1_SUCCESS);
-
-            P3_vmStats.new++;
         }
-        else if(rc== P3_OUT_OF_SWAP){
-            (*fault).kill = TRUE;
-            (*fault).stat = P3_OUT_OF_SWAP;
-            rc = P1_V((*fault).wait);
-            assert(rc==P1_SUCCESS);
-            //break;
-            continue;
+        for (int i = 0; i < n; i++) {
+            if (batch[i] == NULL) {
+                continue;
+            }
+            if (frames[i] == -1) {
+                if (got > 0) {
+                    frames[i] = victims[--got];
+                } else {
+                    // the sweep came up short, the frames served so far are candidates now
+                    rc = P3SwapOut(&frames[i]);
+                    while (rc == P1_SUCCESS && frames[i] == -1) {
+                        // nothing to evict, the frames were freed meanwhile
+                        frames[i] = FrameAlloc();
+                        if (frames[i] == -1) {
+                            rc = P3SwapOut(&frames[i]);
+                        }
+                    }
+                    if (rc == P3_OUT_OF_SWAP) {
+                        // every page in memory needs swap space to be replaced
+                        (*batch[i]).kill = TRUE;
+                        (*batch[i]).stat = P3_OUT_OF_SWAP;
+                        rc = P1_V((*batch[i]).wait);
+                        assert(rc == P1_SUCCESS);
+                        continue;
+                    }
+                    assert(rc == P1_SUCCESS);
+                }
+            }
+            ServeFault(batch[i], frames[i]);
         }
-        rc = P3PageTableGet((*fault).pid, &pageTable);
+    }
+
+    return 0;
+}
+
+/*
+ * Reads the faulting page into the frame, maps it into the process's page
+ * table and wakes the process.
+ */
+static void ServeFault(Fault *fault, int frame) {
+    int rc;
+    int pageInx;
+    void *page;
+    USLOSS_PTE *pageTable;
+
+    pageInx = (*fault).offset / USLOSS_MmuPageSize();
+    rc = P3SwapIn((*fault).pid, pageInx, frame);
+
+    if (rc == P3_EMPTY_PAGE){
+        rc = P3FrameMap(frame, &page);
         assert(rc == P1_SUCCESS);
-        pageTable[pageInx].frame = frame;
-        pageTable[pageInx].incore = 1;
-        pageTable[pageInx].read = 1;
-        pageTable[pageInx].write = 1;
-        P3_vmStats.freeFrames--;
-        freeFrames[frame]=FALSE;
-        rc = USLOSS_MmuSetPageTable(pageTable);
-        assert(rc== P1_SUCCESS);
-        rc = P1_V((*fault).wait);
+        memset(page, 0, USLOSS_MmuPageSize());
+        rc = P3FrameUnmap(frame);
+        assert(rc == P1_SUCCESS);
+
+        P3_vmStats.new++;
+    }
+    else if(rc== P3_OUT_OF_SWAP){
+        FrameRelease(frame);
+        rc = P3SwapDone(frame);
         assert(rc == P1_SUCCESS);
+        (*fault).kill = TRUE;
+        (*fault).stat = P3_OUT_OF_SWAP;
+        rc = P1_V((*fault).wait);
+        assert(rc==P1_SUCCESS);
+        return;
+    }
+    // filling the frame through the scratch mapping set its access bits, the
+    // page matches its swap copy until the process writes it. It stays
+    // referenced so the clock doesn't take it before the process runs.
+    rc = USLOSS_MmuSetAccess(frame, USLOSS_MMU_REF);
+    assert(rc == USLOSS_MMU_OK);
+    rc = P3PageTableGet((*fault).pid, &pageTable);
+    assert(rc == P1_SUCCESS);
+    pageTable[pageInx].frame = frame;
+    pageTable[pageInx].incore = 1;
+    pageTable[pageInx].read = 1;
+    pageTable[pageInx].write = 1;
+    frameInfo[frame].pid = (*fault).pid;
+    frameInfo[frame].page = pageInx;
+    rc = USLOSS_MmuSetPageTable(pageTable);
+    assert(rc== P1_SUCCESS);
+    // the page is mapped, the clock may choose the frame now
+    rc = P3SwapDone(frame);
+    assert(rc == P1_SUCCESS);
+    rc = P1_V((*fault).wait);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ * Takes a frame from the free pool. Returns -1 if the pool is empty. Pagers,
+ * the reclaim daemon and quitting processes all use the pool, so interrupts
+ * are off while it changes. The frame is busy until the page in it is mapped
+ * (P3SwapDone), so a pager that finds nothing to evict waits for it rather
+ * than looking for it in the free pool again.
+ */
+static int FrameAlloc(void) {
+    int frame = -1;
+    int psr = USLOSS_PsrGet();
+    int rc = USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+    assert(rc == USLOSS_DEV_OK);
+    if (freeTop > 0) {
+        frame = freeStack[--freeTop];
+        freeFrames[frame] = FALSE;
+        frameInfo[frame].busy = TRUE;
+        P3_vmStats.freeFrames--;
+    }
+    rc = USLOSS_PsrSet(psr);
+    assert(rc == USLOSS_DEV_OK);
+    return frame;
+}
+
+/*
+ * Returns a frame to the free pool and clears its descriptor. Frames
+ * already in the pool are ignored.
+ */
+static void FrameRelease(int frame) {
+    int psr = USLOSS_PsrGet();
+    int rc = USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+    assert(rc == USLOSS_DEV_OK);
+    if (!freeFrames[frame]) {
+        freeFrames[frame] = TRUE;
+        frameInfo[frame].pid = -1;
+        frameInfo[frame].page = -1;
+        frameInfo[frame].slot = -1;
+        frameInfo[frame].busy = FALSE;
+        freeStack[freeTop++] = frame;
+        P3_vmStats.freeFrames++;
+    }
+    rc = USLOSS_PsrSet(psr);
+    assert(rc == USLOSS_DEV_OK);
+}
+
+/*
+ * Returns the pager with the given pid, or NULL if pid is not a pager.
+ */
+static PagerInfo *FindPager(PID pid) {
+    if (reclaimer.active && reclaimer.pid == pid) {
+        return &reclaimer;
+    }
+    for (int i = 0; i < totalPagers; i++) {
+        if (pagerTracker[i].active && pagerTracker[i].pid == pid) {
+            return &pagerTracker[i];
         }
     }
+    return NULL;
+}
 
-    return 0;
+/*
+ * Forks a pager in the given slot and waits for it to start running.
+ */
+static void SpawnPager(int slot, int tag) {
+    char pagerName[P1_MAXNAME + 1];
+    int rc;
+    for (int j = 0; j < SCRATCH_PAGES; j++) {
+        pagerTracker[slot].scratch[j] = -1;
+    }
+    pagerTracker[slot].active = TRUE;
+    pagerTracker[slot].idle = FALSE;
+    pagerTracker[slot].retire = FALSE;
+    activePagers++;
+    snprintf(pagerName, sizeof(pagerName), "%d", slot);
+    rc = P1_Fork(pagerName, Pager, (void *) slot, USLOSS_MIN_STACK, P3_PAGER_PRIORITY, tag, &pagerTracker[slot].pid);
+    assert(rc == P1_SUCCESS);
+    rc = P1_P(pagerTracker[slot].sid);
+    assert(rc == P1_SUCCESS);
 }
-void enqueue(Fault *fq) {
-    struct Node* curr = faultQueue;
-    if (curr == NULL) {
-        faultQueue = malloc(sizeof(struct Node));
-        faultQueue->fault = fq;
-        faultQueue->next = NULL;
+
+/*
+ * Clock interrupt handler. Runs the phase 2 handler, wakes the reclaim
+ * daemon if free frames are low, then wakes a sleeping extra pager so that
+ * it retires if the pool has been idle for PAGER_IDLE_TIME.
+ */
+static void PagerClock(int type, void *arg) {
+    int now;
+    int rc;
+    clockHandler(type, arg);
+    if (shutDown) {
+        return;
+    }
+    CheckReclaim();
+    if (queueCount > 0 || activePagers <= PAGERS_MIN) {
         return;
     }
-    while (curr->next != NULL) {
-        curr = curr->next;
+    rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+    assert(rc == USLOSS_DEV_OK);
+    if (now - lastBusy < PAGER_IDLE_TIME) {
+        return;
+    }
+    for (int i = PAGERS_MIN; i < totalPagers; i++) {
+        PagerInfo *pager = &pagerTracker[i];
+        if (pager->active && pager->idle) {
+            lastBusy = now;
+            pager->idle = FALSE;
+            pager->retire = TRUE;
+            rc = P1_V(pager->wake);
+            assert(rc == P1_SUCCESS);
+            break;
+        }
+    }
+}
+
+/*
+ * Reclaim daemon. Each time it is woken it evicts pages until highWater
+ * frames are free, and puts the frames back in the free pool.
+ */
+static int Reclaimer(void *arg) {
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0) {
+        int pid; Sys_GetPID(&pid); USLOSS_Console("Process %d called %s from user mode.\n", pid, __FUNCTION__); 
+        USLOSS_IllegalInstruction(); 
+        }
+    int victims[PAGER_BATCH];
+    int rc;
+    reclaimer.pid = P1_GetPid();
+    rc = P1_V(reclaimer.sid);
+    assert(rc == P1_SUCCESS);
+
+    while (!shutDown) {
+        rc = P1_P(reclaimer.wake);
+        assert(rc == P1_SUCCESS);
+        while (!shutDown && P3_vmStats.freeFrames < highWater) {
+            int want = highWater - P3_vmStats.freeFrames;
+            int got;
+            if (want > PAGER_BATCH) {
+                want = PAGER_BATCH;
+            }
+            rc = P3SwapOutBatch(want, victims, &got);
+            assert(rc == P1_SUCCESS);
+            if (got == 0) {
+                // everything else is busy or free
+                break;
+            }
+            for (int i = 0; i < got; i++) {
+                FrameRelease(victims[i]);
+                rc = P3SwapDone(victims[i]);
+                assert(rc == P1_SUCCESS);
+                P3_vmStats.reclaimed++;
+            }
+        }
+        reclaiming = FALSE;
+    }
+    return 0;
+}
+
+/*
+ * Wakes the reclaim daemon if free frames have dropped below the low watermark.
+ */
+static void CheckReclaim(void) {
+    int rc;
+    if (reclaimer.active && !reclaiming && P3_vmStats.freeFrames < lowWater) {
+        reclaiming = TRUE;
+        rc = P1_V(reclaimer.wake);
+        assert(rc == P1_SUCCESS);
+    }
+}
+
+/*
+ * Returns the queue with the most faults, or NULL if they are all empty.
+ */
+static FaultQueue *Busiest(void) {
+    FaultQueue *busiest = NULL;
+    for (int i = 0; i < totalPagers; i++) {
+        FaultQueue *q = &pagerTracker[i].queue;
+        if (q->count > 0 && (busiest == NULL || q->count > busiest->count)) {
+            busiest = q;
+        }
+    }
+    return busiest;
+}
+
+void enqueue(FaultQueue *q, Fault *fq) {
+    int level = fq->priority - 1;
+    if (level < 0) {
+        level = 0;
+    } else if (level >= FAULT_LEVELS) {
+        level = FAULT_LEVELS - 1;
+    }
+    FaultRing *ring = &q->rings[level];
+    assert(ring->count < P1_MAXPROC);
+    fq->arrived = q->served;
+    ring->faults[(ring->head + ring->count) % P1_MAXPROC] = fq;
+    ring->count++;
+    q->count++;
+    queueCount++;
+    if (queueCount > P3_vmStats.maxQueue) {
+        P3_vmStats.maxQueue = queueCount;
     }
-    curr->next = malloc(sizeof(struct Node));
-    curr->next->fault = fq;
-    curr->next->next = NULL;
 }
-void dequeue(Fault **rv) {
-    if (faultQueue == NULL) {
+/*
+ * Returns the oldest fault of the highest priority, unless some fault has
+ * waited FAULT_AGE or more dequeues, in which case the oldest such fault
+ * goes first so that low priority faults don't starve.
+ */
+void dequeue(FaultQueue *q, Fault **rv) {
+    FaultRing *pick = NULL;
+    FaultRing *aged = NULL;
+    if (q->count == 0) {
         *rv = NULL;
-    } else {
-        struct Node *clean = faultQueue;
-        *rv = faultQueue->fault;
-        faultQueue = faultQueue->next;
-        free(clean);
+        return;
+    }
+    for (int i = 0; i < FAULT_LEVELS; i++) {
+        FaultRing *ring = &q->rings[i];
+        if (ring->count == 0) {
+            continue;
+        }
+        Fault *head = ring->faults[ring->head];
+        if (pick == NULL) {
+            pick = ring;
+        }
+        if (q->served - head->arrived >= FAULT_AGE &&
+            (aged == NULL || head->arrived < aged->faults[aged->head]->arrived)) {
+            aged = ring;
+        }
+    }
+    if (aged != NULL) {
+        pick = aged;
     }
+    *rv = pick->faults[pick->head];
+    pick->head = (pick->head + 1) % P1_MAXPROC;
+    pick->count--;
+    q->count--;
+    q->served++;
+    queueCount--;
 }
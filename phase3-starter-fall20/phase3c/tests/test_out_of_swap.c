@@ -97,10 +97,19 @@ void test_cleanup(int argc, char **argv) {
 
 #include "phase3Int.h"
 
+int P3SwapDisks(int disks) {return P1_SUCCESS;}
 int P3SwapInit(int pages, int frames) {return P1_SUCCESS;}
 int P3SwapShutdown(void) {return P1_SUCCESS;}
 int P3SwapFreeAll(PID pid) {return P1_SUCCESS;}
+int P3SwapLockTable(PID pid) {return P1_SUCCESS;}
+int P3SwapUnlockTable(PID pid) {return P1_SUCCESS;}
 int P3SwapOut(int *frame) {return P1_SUCCESS;}
+int P3SwapOutBatch(int count, int *frames, int *chosen) {*chosen = 0; return P1_SUCCESS;}
+int P3SwapReadAhead(int window) {return P1_SUCCESS;}
+int P3SwapCacheSize(int percent) {return P1_SUCCESS;}
+int P3SwapFastSize(int pages) {return P1_SUCCESS;}
+int P3SwapBufFree(PID pid) {return P1_SUCCESS;}
+int P3SwapDone(int frame) {return P1_SUCCESS;}
 int P3SwapIn(PID pid, int page, int frame) {return P3_OUT_OF_SWAP;}
 
 
@@ -18,6 +18,14 @@
  */
 #define P3_PAGER_PRIORITY   2
 
+/*
+ * Most pages read ahead of a page brought in from swap. Read-ahead only
+ * uses free frames above the low watermark of the reclaim daemon
+ * (P3_VmWatermarks). Without the daemon there are no free frames once
+ * memory is full, so from then on no pages are read ahead.
+ */
+#define P3_MAX_READ_AHEAD   3
+
 /*
  * Swap disk.
  */
@@ -35,8 +43,29 @@ typedef struct P3_VmStats {
     int faults;     /* # of page faults */
     int new;        /* # faults caused by previously unused pages*/
     int pageIns;    /* # faults that required reading page from disk */
-    int pageOuts;   /* # faults that required writing a page to disk */
+    int pageOuts;   /* # pages written to disk */
+    int cleanDrops; /* # pages evicted without a write, their swap copy was valid */
+    int zeroPages;  /* # dirty pages swapped out as all zeros, without a write */
     int replaced;   /* # pages replaced */
+    int maxQueue;   /* high-water mark of the fault queue */
+    int wakeups;    /* # of batches of faults taken by the pagers */
+    int spawned;    /* # of pagers added to the pool under load */
+    int retired;    /* # of idle pagers retired from the pool */
+    int stolen;     /* # of faults taken from another pager's queue */
+    int reclaimed;  /* # of frames freed by the reclaim daemon */
+    int prefetched; /* # of pages brought in by swap read-ahead */
+    int diskOps;    /* # of swap disk requests */
+    int seekDistance; /* total # of tracks the swap disk head moved */
+    int cached;     /* # of pages stored in the compressed swap cache */
+    int cacheHits;  /* # of page-ins served from the compressed swap cache */
+    int dedupHits;  /* # of swapped out pages that shared an identical slot */
+    int shared;     /* # of swap slots saved by sharing identical pages */
+    int ioWaits;    /* # of times a pager waited for swap I/O already in flight */
+    int fastIns;    /* # page-ins served from the fast swap tier */
+    int fastOuts;   /* # pages written to the fast swap tier */
+    int slowIns;    /* # page-ins read from the swap disks */
+    int promoted;   /* # pages copied up to the fast tier as they refault */
+    int demoted;    /* # cold pages moved down from the fast tier */
 } P3_VmStats;
 
 extern P3_VmStats P3_vmStats;
@@ -57,12 +86,22 @@ extern P3_VmStats P3_vmStats;
 #define P3_OUT_OF_PAGES             -39
 #define P3_INVALID_FRAME            -40
 #define P3_INVALID_PAGE             -41
+#define P3_INVALID_WATERMARKS       -42
+#define P3_INVALID_READ_AHEAD       -43
+#define P3_INVALID_CACHE_SIZE       -44
+#define P3_INVALID_SWAP_DISKS       -45
+#define P3_INVALID_FAST_SIZE        -46
 
 #ifndef CHECKRETURN
 #define CHECKRETURN __attribute__((warn_unused_result))
 #endif
 
 extern int          P3_VmInit(int mappings, int pages, int frames, int pagers) CHECKRETURN;
+extern int          P3_VmWatermarks(int low, int high) CHECKRETURN;
+extern int          P3_VmReadAhead(int window) CHECKRETURN;
+extern int          P3_VmSwapCache(int percent) CHECKRETURN;
+extern int          P3_VmSwapDisks(int disks) CHECKRETURN;
+extern int          P3_VmFastSwap(int pages) CHECKRETURN;
 extern void         P3_VmDestroy(void);
 extern  USLOSS_PTE  *P3_AllocatePageTable(int pid) CHECKRETURN;
 extern  void        P3_FreePageTable(int pid);
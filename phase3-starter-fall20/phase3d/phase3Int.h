@@ -15,6 +15,14 @@
 typedef int SID;    // semaphore ID
 typedef int PID;    // PID
 
+// frame descriptor, indexed by frame number (reverse map)
+typedef struct P3FrameInfo {
+    PID pid;        // owner of the page in the frame, -1 if none
+    int page;       // owner's page that maps to the frame
+    int slot;       // swap slot that holds the page, -1 if none
+    int busy;       // TRUE while a pager is evicting or filling the frame
+} P3FrameInfo;
+
 // helpful macro
 #define CheckMode() \
     if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0) { \
@@ -28,6 +36,7 @@ typedef int PID;    // PID
 
 int         P3PageTableGet(PID pid, USLOSS_PTE **table) CHECKRETURN;
 int         P3PageTableSet(PID pid, USLOSS_PTE *table) CHECKRETURN;
+int         P3SwapMapGet(PID pid, int **map) CHECKRETURN;
 
 
 // Phase 3b
@@ -42,16 +51,28 @@ int         P3FrameShutdown(void) CHECKRETURN;
 int         P3FrameFreeAll(PID pid) CHECKRETURN;
 int         P3FrameMap(int frame, void **addr) CHECKRETURN;
 int         P3FrameUnmap(int frame) CHECKRETURN;
+int         P3FrameInfoGet(int frame, P3FrameInfo **info) CHECKRETURN;
+int         P3FrameSpare(int *frame) CHECKRETURN;
 
 int         P3PagerInit(int pages, int frames, int pagers) CHECKRETURN;
 int         P3PagerShutdown(void)  CHECKRETURN;
+int         P3ReclaimInit(int low, int high) CHECKRETURN;
 
 // Phase 3d
 
+int         P3SwapDisks(int disks) CHECKRETURN;
 int         P3SwapInit(int pages, int frames) CHECKRETURN;
 int         P3SwapShutdown(void) CHECKRETURN;
 int         P3SwapFreeAll(PID pid) CHECKRETURN;
+int         P3SwapLockTable(PID pid) CHECKRETURN;
+int         P3SwapUnlockTable(PID pid) CHECKRETURN;
 int         P3SwapOut(int *frame) CHECKRETURN;
+int         P3SwapOutBatch(int count, int *frames, int *chosen) CHECKRETURN;
 int         P3SwapIn(PID pid, int page, int frame) CHECKRETURN;
+int         P3SwapDone(int frame) CHECKRETURN;
+int         P3SwapReadAhead(int window) CHECKRETURN;
+int         P3SwapCacheSize(int percent) CHECKRETURN;
+int         P3SwapFastSize(int pages) CHECKRETURN;
+int         P3SwapBufFree(PID pid) CHECKRETURN;
 
 #endif
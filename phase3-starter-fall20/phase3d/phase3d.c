@@ -10,24 +10,48 @@
 
 NOTES ON SYNCHRONIZATION
 
-There are various shared resources that require proper synchronization. 
+There are various shared resources that require proper synchronization. They are protected by
+separate locks so that pagers only wait for each other when they need the same thing.
 
 Swap space. Free swap space is a shared resource, we don't want multiple pagers choosing the
-same free space to hold a page. You'll need a mutex around the free swap space.
+same free space to hold a page. swapLock protects the slots, the processes' swap maps, the
+compressed cache and the hash table.
 
 The clock hand is also a shared resource.
 
 The frames are a shared resource in that we don't want multiple pagers to choose the same frame via
 the clock algorithm. That's the purpose of marking a frame as "busy" in the pseudo-code below. 
-Pagers ignore busy frames when running the clock algorithm.
+Pagers ignore busy frames when running the clock algorithm. clockLock protects the clock hand and
+the busy bits. A busy frame belongs to the pager that marked it, which may then use it without
+clockLock. The busy bit is kept in the frame's descriptor. A frame taken from the free pool, for a
+fault or for read-ahead, is busy until its page is mapped, and a frame put back in the pool is not
+busy. So a pager that finds every frame in use busy knows another pager will be done with one.
 
 A process's page table is a shared resource with the pager. The process changes its page table
 when it quits, and a pager changes the page table when it selects one of the process's pages
-in the clock algorithm. 
-
-Normally the pagers would perform I/O concurrently, which means they would release the mutex
-while performing disk I/O. I made it simpler by having the pagers hold the mutex while they perform
-disk I/O.
+in the clock algorithm. Each page table has its own lock in tableLocks, indexed by pid. A quitting
+process holds it (P3SwapLockTable) while its frames are freed and while its page table is freed.
+Frames a pager has marked busy are left to the pager with the pid in their descriptor cleared, so
+a pager checks the pid again once it holds the lock. The table
+is fixed, so the lock of a process that quit is reused by the next process with its pid and no
+semaphores are created after P3SwapInit.
+
+A tableLock may be taken while holding swapLock, never the other way round. clockLock is never
+held together with another lock, so a frame mapped by read-ahead under swapLock stays busy until
+swapLock is released.
+
+The pagers perform I/O concurrently: they release swapLock while P2_DiskRead/P2_DiskWrite run,
+including the reads that compare a page with a possible duplicate. Before releasing it a pager
+marks the slots of the request as being written or being read, and keeps the frames busy so the
+clock doesn't choose them. A victim is unmapped under its tableLock before its dirty bit is read
+and it is copied to the pager's buffer, so its process can't change it once the copy is taken, nor
+after the dirty bit is cleared. From then until the copy is stored its slot is marked as being
+written. Anyone that needs a slot with I/O in flight (a fault on the page, the process quitting, or
+a pager reusing the slot for a new copy) waits on ioDone and checks again when it is woken, rather
+than issuing its own I/O. A slot being written is not free, hashed or in the cache, so allocation
+and sharing never see one. A slot being read keeps its hash, its copy doesn't change, but it isn't
+compared with another page until the read is done. Since a process may quit whenever a pager
+waits, a pager doesn't look at a victim's descriptor after releasing its tableLock.
 
 ***************/
 
@@ -62,91 +86,659 @@ static int init = FALSE;
 struct Hold{
 	int pid;
 	int page;
-	int frame;
-	int track;
+	int unit;		// disk unit the slot is on
+	int track;		// track on the unit
 	int start;
 	int total;
-	int room;
-	struct Hold * next;
+	unsigned char *cached;	// compressed copy of the page, NULL if on disk
+	int cachedLen;		// # of bytes in cached
+	int zero;		// TRUE if the page is all zeros and isn't on disk
+	int refs;		// # of pages whose copy is in the slot
+	unsigned int hash;	// hash of the copy, if hashed
+	int hashed;		// TRUE if the slot is in the hash table
+	int hashNext;		// next slot in the hash bucket
+	int io;			// IO_NONE, or the disk request in flight on the slot
+	char *fast;		// copy in the fast swap tier, NULL if none
+	int slow;		// TRUE if the disk copy is valid as well as the fast one
+	int fastPrev;		// next colder slot in the fast tier, -1 if none
+	int fastNext;		// next hotter slot in the fast tier, -1 if none
+	int refaults;		// # of times the page was read back in from swap
 };
 
-struct InFrame{
-	int pid;
-	int frame;
-	int page;
-	struct InFrame *next;
-};
+#define IO_NONE		0
+#define IO_WRITE	1	// being written, the copy on disk isn't complete
+#define IO_READ		2	// being read into a frame
 
-struct Mutex {
-	int pid;
-	int sid;
-	struct Mutex *next;
+/*
+ * A disk write set up by writeOut, done by flush without swapLock.
+ */
+struct Io {
+	int slot;	// first slot
+	int count;	// # of slots in a row
+	char *buf;
+	int owned;	// TRUE if buf is a demoted fast copy, freed after the write
 };
 
-static int *chooseF ; // indicates whether frame is busy
-static struct Hold *swapSpace;  // holds informaton about pages on disk
-static struct Mutex* exclusive;  // hold the semaphores for the processes
+#define WORD_BITS	(8 * sizeof(unsigned int))
+#define CLUSTER		4	// most pages moved in one disk request, > P3_MAX_READ_AHEAD
+#define HOT		2	// # of refaults that put a page in the fast swap tier
+
+static int *validF;	// TRUE if the page in the frame matches its swap copy
+static struct Hold *swapSpace;  // holds informaton about pages on disk, indexed by slot
+static unsigned int *freeMap;	// bit set -> slot is free
+static int numSlots;		// number of slots in swapSpace
+static int perTrack;		// number of slots on a track
+static int numTracks;		// number of tracks on all the swap units, slot / perTrack
+static int *trackFree;		// number of free slots on each track
+static int *buckets;		// hash of a page -> first slot in its bucket
+static int swapDisks = 1 << P3_SWAP_DISK;	// bit set -> disk unit holds swap
+static int units[USLOSS_DISK_UNITS];	// the swap units, in order
+static int numUnits;		// number of swap units
+static int nextUnit = 0;	// index in units of the next unit to place a run on
+static int firstTrack[USLOSS_DISK_UNITS];	// first track of each unit, in slot order
+static int unitTracks[USLOSS_DISK_UNITS];	// number of tracks on each unit
+static int heads[USLOSS_DISK_UNITS];	// track of the last request to each unit
 static int size;		// holds the size of the page
-static struct InFrame *frames;  // holds the information for pages in frames
-
-/*
- *Creates the list (size of frames) to hold information about pages on a given frame. 
-*/
-void makeFrameList(int given){
-	struct InFrame *prev = NULL;
-	int going = 0;
-	while (going < given){
-
-		struct InFrame *temp = malloc(sizeof(struct InFrame));
-		temp -> pid =-1;
-		temp -> frame = going;
-		temp -> page = -1;
-		temp -> next = NULL;
-		if (frames == NULL){
-			frames = temp;
-		}
-		if (prev !=NULL){
-			prev -> next = temp;
-		}
-		going +=1;
-		prev = temp;
-	}
-
-}
+static char *ioBuf[P1_MAXPROC];	// per-pager disk buffer, CLUSTER pages and a scratch page, indexed by pid
+static int hand = -1;		// clock hand
+static int readAhead = 0;	// # of pages read ahead of a swap-in
+static int cacheLimit = 0;	// most bytes held by the compressed swap cache
+static int cacheUsed = 0;	// bytes held by the compressed swap cache
+static int fastLimit = 0;	// most pages held by the fast swap tier
+static int fastUsed = 0;	// pages held by the fast swap tier
+static int fastHead = -1;	// coldest slot in the fast tier
+static int fastTail = -1;	// hottest slot in the fast tier
+static int swapLock;		// protects the swap data structures
+static int clockLock;		// protects the clock hand and the busy bits
+static int tableLocks[P1_MAXPROC];	// protects each process's page table, indexed by pid
+static int ioDone;		// V'ed when I/O finishes, for those waiting on it
+static int ioWaiters = 0;	// # of processes P'ed on ioDone
+static int frameDone;		// V'ed when a busy frame is done with, for pagers the clock had nothing for
+static int frameWaiters = 0;	// # of processes P'ed on frameDone
 
 /*
- *Creates the list to hold information about the swapspace.
+ *Creates the array to hold information about the swapspace. Slots are laid
+ * out track by track, one unit after another, and all of them start out free.
 */
 void makeHoldList(int space, int sectors, int total){
 	int going= 0;
 	int tracks = 0;
 	int startSec = 0;
-	struct Hold *prev = NULL;
+	int u = 0;		// index in units
+	int unitTrack = 0;	// track on units[u]
+	int mapWords = (space + WORD_BITS - 1) / WORD_BITS;
+	numSlots = space;
+	perTrack = total / sectors;
+	numTracks = space / perTrack;
+	swapSpace = malloc(sizeof(struct Hold) * (space > 0 ? space : 1));
+	freeMap = calloc(mapWords > 0 ? mapWords : 1, sizeof(unsigned int));
+	trackFree = malloc(sizeof(int) * (numTracks > 0 ? numTracks : 1));
+	buckets = malloc(sizeof(int) * (space > 0 ? space : 1));
 	while (going < space){
-		struct Hold *temp = malloc(sizeof(struct Hold));
+		struct Hold *temp = &swapSpace[going];
 		temp -> pid = -1;
-		temp -> frame = -1;
 		temp -> page = -1;
-		temp -> room = 0; // can be filled
-		temp -> next = NULL;
 		temp -> start = startSec;
 		temp -> total = sectors;
-		temp -> track = tracks;
+		temp -> unit = units[u];
+		temp -> track = unitTrack;
+		temp -> cached = NULL;
+		temp -> cachedLen = 0;
+		temp -> zero = FALSE;
+		temp -> refs = 0;
+		temp -> hashed = FALSE;
+		temp -> hashNext = -1;
+		temp -> io = IO_NONE;
+		temp -> fast = NULL;
+		temp -> slow = FALSE;
+		temp -> fastPrev = -1;
+		temp -> fastNext = -1;
+		temp -> refaults = 0;
+		buckets[going] = -1;
+		freeMap[going / WORD_BITS] |= 1u << (going % WORD_BITS);
 		startSec += sectors;
 		if (startSec % total == 0){
+			trackFree[tracks] = perTrack;
 			tracks += 1;
 			startSec = 0;
+			unitTrack += 1;
+			if (unitTrack == unitTracks[units[u]]){
+				u++;
+				unitTrack = 0;
+			}
+		}
+		going +=1;
+	}
+}
+
+/*
+ *Returns TRUE if the slot is free.
+*/
+static int slotFree(int slot){
+	return (freeMap[slot / WORD_BITS] & (1u << (slot % WORD_BITS))) != 0;
+}
+
+/*
+ *Marks the free slot used by the page and records it in the process's swap map.
+*/
+static void takeSlot(int slot, int pid, int page, int *map){
+	assert(slotFree(slot));
+	freeMap[slot / WORD_BITS] &= ~(1u << (slot % WORD_BITS));
+	trackFree[slot / perTrack]--;
+	swapSpace[slot].refs = 1;
+	swapSpace[slot].pid = pid;
+	swapSpace[slot].page = page;
+	map[page] = slot;
+	P3_vmStats.freeBlocks--;
+}
+
+/*
+ *Looks for count free slots in a row on the track. Returns the first
+ * of them, or -1 if there is no such run.
+*/
+static int runOnTrack(int track, int count){
+	int slot;
+	int run = 0;
+	if (trackFree[track] < count){
+		return -1;
+	}
+	for (slot = track * perTrack; slot < (track + 1) * perTrack; slot++){
+		if (slotFree(slot)){
+			run++;
+			if (run == count){
+				return slot - count + 1;
+			}
+		}else{
+			run = 0;
 		}
-		if (swapSpace == NULL){
-			swapSpace = temp;
+	}
+	return -1;
+}
+
+/*
+ *Looks for count free slots in a row on one track of the unit, trying the tracks
+ * in order of distance from near. Returns the first of them, or -1 if there is
+ * no such run.
+*/
+static int findRun(int unit, int near, int count){
+	int d;
+	int slot;
+	int first = firstTrack[unit];
+	int tracks = unitTracks[unit];
+	for (d = 0; d < tracks; d++){
+		if (near - d >= 0 && (slot = runOnTrack(first + near - d, count)) != -1){
+			return slot;
 		}
-		if (prev != NULL){
-			prev -> next = temp;
+		if (d > 0 && near + d < tracks && (slot = runOnTrack(first + near + d, count)) != -1){
+			return slot;
 		}
-		prev = temp;
-		
-		going +=1;
 	}
+	return -1;
+}
+
+/*
+ *Looks for count free slots in a row, near the head of the units in turn so that
+ * consecutive runs go to different units. Returns the first of them, or -1 if
+ * there is no such run.
+*/
+static int placeRun(int count){
+	int i;
+	int slot;
+	for (i = 0; i < numUnits; i++){
+		int unit = units[(nextUnit + i) % numUnits];
+		slot = findRun(unit, heads[unit], count);
+		if (slot != -1){
+			nextUnit = (nextUnit + i + 1) % numUnits;
+			return slot;
+		}
+	}
+	return -1;
+}
+
+/*
+ *Gives the page a free slot as close as possible to the process's previous
+ * page, so that its pages stay together on one unit, or else near the head of
+ * the next unit in turn. Returns the slot, or -1 if the swap units are full.
+*/
+static int allocSlot(int pid, int page, int *map){
+	int slot = -1;
+	if (page > 0 && map[page - 1] != -1){
+		// right after the previous page keeps them in read-ahead order
+		slot = map[page - 1] + 1;
+		if (slot < numSlots && swapSpace[slot].start != 0 && slotFree(slot)){
+			takeSlot(slot, pid, page, map);
+			return slot;
+		}
+		slot = findRun(swapSpace[map[page - 1]].unit, swapSpace[map[page - 1]].track, 1);
+	}
+	if (slot == -1){
+		slot = placeRun(1);
+	}
+	if (slot != -1){
+		takeSlot(slot, pid, page, map);
+	}
+	return slot;
+}
+
+/*
+ *Compresses the page with run-length (PackBits) coding. A header byte h of
+ * 0..127 is followed by h+1 literal bytes, -1..-127 by one byte repeated 1-h
+ * times. Returns the compressed length, or -1 if it would be more than limit.
+*/
+static int pack(unsigned char *in, unsigned char *out, int limit){
+	int i = 0;
+	int len = 0;
+	while (i < size){
+		int run = 1;
+		while (i + run < size && run < 128 && in[i + run] == in[i]){
+			run++;
+		}
+		if (run > 1){
+			if (len + 2 > limit){
+				return -1;
+			}
+			out[len++] = (unsigned char) (1 - run);
+			out[len++] = in[i];
+			i += run;
+		}else{
+			// literals up to the start of the next run
+			int lit = 1;
+			while (i + lit < size && lit < 128 &&
+			    !(i + lit + 1 < size && in[i + lit] == in[i + lit + 1])){
+				lit++;
+			}
+			if (len + 1 + lit > limit){
+				return -1;
+			}
+			out[len++] = (unsigned char) (lit - 1);
+			memcpy(out + len, in + i, lit);
+			len += lit;
+			i += lit;
+		}
+	}
+	return len;
+}
+
+/*
+ *Opposite of pack.
+*/
+static void unpack(unsigned char *in, int len, unsigned char *out){
+	int i = 0;
+	int o = 0;
+	while (i < len){
+		signed char h = (signed char) in[i++];
+		if (h >= 0){
+			memcpy(out + o, in + i, h + 1);
+			i += h + 1;
+			o += h + 1;
+		}else{
+			memset(out + o, in[i++], 1 - h);
+			o += 1 - h;
+		}
+	}
+	assert(o == size);
+}
+
+/*
+ *Returns TRUE if the page is all zeros. Checks a word at a time.
+*/
+static int isZero(void *page){
+	unsigned long *word = page;
+	int n = size / sizeof(unsigned long);
+	int i;
+	for (i = 0; i < n; i++){
+		if (word[i] != 0){
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/*
+ *Drops the slot's compressed copy, if it has one.
+*/
+static void uncache(int slot){
+	struct Hold *temp = &swapSpace[slot];
+	if (temp->cached != NULL){
+		free(temp->cached);
+		cacheUsed -= temp->cachedLen;
+		temp->cached = NULL;
+		temp->cachedLen = 0;
+	}
+}
+
+/*
+ *Stores a compressed copy of the page in the swap cache in place of the slot's
+ * disk copy. Returns FALSE if the cache is off, the page doesn't compress, or
+ * there is no room, in which case the page has to be written to disk.
+*/
+static int cacheStore(int slot, char *page){
+	uncache(slot);
+	if (cacheLimit == 0){
+		return FALSE;
+	}
+	unsigned char *blob = malloc(size);
+	assert(blob != NULL);
+	int len = pack((unsigned char *) page, blob, size - 1);
+	if (len == -1 || cacheUsed + len > cacheLimit){
+		free(blob);
+		return FALSE;
+	}
+	swapSpace[slot].cached = realloc(blob, len);
+	swapSpace[slot].cachedLen = len;
+	cacheUsed += len;
+	P3_vmStats.cached++;
+	return TRUE;
+}
+
+/*
+ *Adds the slot to the hot end of the fast tier's list.
+*/
+static void fastLink(int slot){
+	struct Hold *temp = &swapSpace[slot];
+	temp->fastPrev = fastTail;
+	temp->fastNext = -1;
+	if (fastTail != -1){
+		swapSpace[fastTail].fastNext = slot;
+	}else{
+		fastHead = slot;
+	}
+	fastTail = slot;
+}
+
+/*
+ *Takes the slot out of the fast tier's list.
+*/
+static void fastUnlink(int slot){
+	struct Hold *temp = &swapSpace[slot];
+	if (temp->fastPrev != -1){
+		swapSpace[temp->fastPrev].fastNext = temp->fastNext;
+	}else{
+		fastHead = temp->fastNext;
+	}
+	if (temp->fastNext != -1){
+		swapSpace[temp->fastNext].fastPrev = temp->fastPrev;
+	}else{
+		fastTail = temp->fastPrev;
+	}
+	temp->fastPrev = -1;
+	temp->fastNext = -1;
+}
+
+/*
+ *Drops the slot's copy in the fast tier, if it has one.
+*/
+static void unfast(int slot){
+	struct Hold *temp = &swapSpace[slot];
+	if (temp->fast != NULL){
+		fastUnlink(slot);
+		free(temp->fast);
+		temp->fast = NULL;
+		temp->slow = FALSE;
+		fastUsed--;
+	}
+}
+
+/*
+ *Hashes the page contents (FNV-1a).
+*/
+static unsigned int hashPage(unsigned char *page){
+	unsigned int hash = 2166136261u;
+	int i;
+	for (i = 0; i < size; i++){
+		hash = (hash ^ page[i]) * 16777619u;
+	}
+	return hash;
+}
+
+/*
+ *Adds the slot to the hash table once it holds a copy of its page.
+*/
+static void hashAdd(int slot, unsigned int hash){
+	int bucket = hash % numSlots;
+	swapSpace[slot].hash = hash;
+	swapSpace[slot].hashed = TRUE;
+	swapSpace[slot].hashNext = buckets[bucket];
+	buckets[bucket] = slot;
+}
+
+/*
+ *Takes the slot out of the hash table, before its copy changes or it is freed.
+*/
+static void unhash(int slot){
+	if (!swapSpace[slot].hashed){
+		return;
+	}
+	int *prev = &buckets[swapSpace[slot].hash % numSlots];
+	while (*prev != slot){
+		prev = &swapSpace[*prev].hashNext;
+	}
+	*prev = swapSpace[slot].hashNext;
+	swapSpace[slot].hashed = FALSE;
+	swapSpace[slot].hashNext = -1;
+}
+
+/*
+ *Puts the slot back in the bitmap.
+*/
+static void freeSlot(int slot){
+	assert(!slotFree(slot));
+	unhash(slot);
+	swapSpace[slot].refs = 0;
+	swapSpace[slot].refaults = 0;
+	uncache(slot);
+	unfast(slot);
+	swapSpace[slot].zero = FALSE;
+	swapSpace[slot].io = IO_NONE;
+	freeMap[slot / WORD_BITS] |= 1u << (slot % WORD_BITS);
+	trackFree[slot / perTrack]++;
+	swapSpace[slot].pid = -1;
+	swapSpace[slot].page = -1;
+	P3_vmStats.freeBlocks++;
+}
+
+/*
+ *Drops a page's reference to its slot, freeing the slot with the last one.
+*/
+static void release(int slot){
+	if (swapSpace[slot].refs > 1){
+		swapSpace[slot].refs--;
+		P3_vmStats.shared--;
+	}else{
+		freeSlot(slot);
+	}
+}
+
+/*
+ *Moves the unit's head to the track for a swap request and counts the seek.
+*/
+static void seek(int unit, int track){
+	P3_vmStats.seekDistance += abs(track - heads[unit]);
+	P3_vmStats.diskOps++;
+	heads[unit] = track;
+}
+
+/*
+ *Waits for I/O in progress to finish. swapLock is released while waiting, so
+ * the caller has to look at the slot again.
+*/
+static void waitIo(void){
+	ioWaiters++;
+	P3_vmStats.ioWaits++;
+	assert(P1_SUCCESS == P1_V(swapLock));
+	assert(P1_SUCCESS == P1_P(ioDone));
+	assert(P1_SUCCESS == P1_P(swapLock));
+}
+
+/*
+ *Wakes everyone waiting for I/O, each checks again for its own.
+*/
+static void wakeIo(void){
+	while (ioWaiters > 0){
+		ioWaiters--;
+		assert(P1_SUCCESS == P1_V(ioDone));
+	}
+}
+
+/*
+ *Looks for a slot that already holds a copy of the page. Slots with the same
+ * hash are compared byte for byte, reading them into scratch from the fast
+ * tier, the cache or the disk. swapLock is released during a disk read, the
+ * slot is marked as being read so that it isn't changed or freed meanwhile.
+ * Slots with other I/O in flight are skipped. Returns the slot, or -1 if there
+ * is none.
+*/
+static int findDup(unsigned int hash, char *page, char *scratch){
+	int slot;
+	for (slot = buckets[hash % numSlots]; slot != -1; slot = swapSpace[slot].hashNext){
+		struct Hold *temp = &swapSpace[slot];
+		if (temp->hash != hash){
+			continue;
+		}
+		if (temp->fast != NULL){
+			memcpy(scratch, temp->fast, size);
+		}else if (temp->cached != NULL){
+			unpack(temp->cached, temp->cachedLen, (unsigned char *) scratch);
+		}else if (temp->io != IO_NONE){
+			continue;
+		}else{
+			temp->io = IO_READ;
+			seek(temp->unit, temp->track);
+			assert(P1_SUCCESS == P1_V(swapLock));
+			assert(P1_SUCCESS == P2_DiskRead(temp->unit, temp->track, temp->start, temp->total, scratch));
+			assert(P1_SUCCESS == P1_P(swapLock));
+			temp->io = IO_NONE;
+			wakeIo();
+		}
+		if (memcmp(scratch, page, size) == 0){
+			return slot;
+		}
+	}
+	return -1;
+}
+
+/*
+ *Waits for a busy frame to be done with. clockLock is released while waiting,
+ * so the caller has to run the clock again.
+*/
+static void waitFrame(void){
+	frameWaiters++;
+	assert(P1_SUCCESS == P1_V(clockLock));
+	assert(P1_SUCCESS == P1_P(frameDone));
+	assert(P1_SUCCESS == P1_P(clockLock));
+}
+
+/*
+ *Wakes everyone waiting for a busy frame. Called with clockLock.
+*/
+static void wakeFrame(void){
+	while (frameWaiters > 0){
+		frameWaiters--;
+		assert(P1_SUCCESS == P1_V(frameDone));
+	}
+}
+
+/*
+ *Does the disk writes set up by writeOut. swapLock is held on entry and on
+ * return but released while the disk is busy. The slots are hashed once their
+ * copies are complete.
+*/
+static void flush(struct Io *ios, int n){
+	int i, j;
+	if (n == 0){
+		return;
+	}
+	for (i = 0; i < n; i++){
+		seek(swapSpace[ios[i].slot].unit, swapSpace[ios[i].slot].track);
+	}
+	assert(P1_SUCCESS == P1_V(swapLock));
+	for (i = 0; i < n; i++){
+		struct Hold *temp = &swapSpace[ios[i].slot];
+		assert(P1_SUCCESS == P2_DiskWrite(temp->unit, temp->track, temp->start, temp->total * ios[i].count, ios[i].buf));
+	}
+	assert(P1_SUCCESS == P1_P(swapLock));
+	for (i = 0; i < n; i++){
+		for (j = ios[i].slot; j < ios[i].slot + ios[i].count; j++){
+			swapSpace[j].io = IO_NONE;
+			hashAdd(j, swapSpace[j].hash);
+		}
+		if (ios[i].owned){
+			free(ios[i].buf);
+		}
+	}
+	wakeIo();
+}
+
+/*
+ *Moves the coldest page in the fast tier down to the disk tier to make room. A
+ * copy that is also on disk is just dropped. Otherwise, if ios isn't NULL, the
+ * copy becomes the buffer of a write added to ios, and flush frees it. A slot
+ * with a copy only in the fast tier is never rewritten while it is there, its
+ * page takes the copy when it is read back in. The tier is kept in LRU order
+ * from fastHead, so the coldest copy is found without looking at every slot.
+ * Returns FALSE if nothing could be moved.
+*/
+static int demote(struct Io *ios, int *numIos){
+	int cold = fastHead;
+	// the list runs from the coldest copy, skip those that can't move now
+	while (cold != -1 && (swapSpace[cold].io != IO_NONE || (!swapSpace[cold].slow && ios == NULL))){
+		cold = swapSpace[cold].fastNext;
+	}
+	if (cold == -1){
+		return FALSE;
+	}
+	struct Hold *temp = &swapSpace[cold];
+	if (temp->slow){
+		unfast(cold);
+	}else{
+		unhash(cold); // hashed again once the write is done
+		ios[*numIos].slot = cold;
+		ios[*numIos].count = 1;
+		ios[*numIos].buf = temp->fast;
+		ios[*numIos].owned = TRUE;
+		(*numIos)++;
+		fastUnlink(cold);
+		temp->fast = NULL;
+		temp->io = IO_WRITE;
+		fastUsed--;
+		P3_vmStats.pageOuts++;
+	}
+	P3_vmStats.demoted++;
+	return TRUE;
+}
+
+/*
+ *Puts a copy of the page in the fast tier for the slot, demoting the coldest
+ * page if the tier is full. slow is TRUE if the slot's disk copy is valid too.
+ * Returns FALSE if the tier is off or there is no room.
+*/
+static int fastStore(int slot, char *page, int slow, struct Io *ios, int *numIos){
+	if (fastUsed >= fastLimit && (fastLimit == 0 || !demote(ios, numIos) || fastUsed >= fastLimit)){
+		return FALSE;
+	}
+	struct Hold *temp = &swapSpace[slot];
+	temp->fast = malloc(size);
+	assert(temp->fast != NULL);
+	memcpy(temp->fast, page, size);
+	temp->slow = slow;
+	fastLink(slot);
+	fastUsed++;
+	return TRUE;
+}
+
+/*
+ *Returns the calling pager's disk buffer, allocating it the first time the
+ * pager does swap I/O. The disk is driven by the phase 2 driver process, whose
+ * page table does not have the pager's scratch mapping of the frame, so the
+ * transfer cannot target the frame's VM address directly.
+*/
+static char *getBuf(void){
+	int pid = P1_GetPid();
+	if (ioBuf[pid] == NULL){
+		ioBuf[pid] = malloc(size * (CLUSTER + 1));
+		assert(ioBuf[pid] != NULL);
+	}
+	return ioBuf[pid];
 }
 
 /*
@@ -181,22 +773,50 @@ P3SwapInit(int pages, int frames)
 		return P3_ALREADY_INITIALIZED;
 	}
 	int num;
-	int secsInTrack;
-	int sectorSize;
+	int secsInTrack = 0;
+	int sectorSize = 0;
+	int unitSecs;
+	int unitSize;
+	int tracks = 0;
+	int i;
 	size= USLOSS_MmuPageSize();
-	assert(P1_SUCCESS == P2_DiskSize(P3_SWAP_DISK, &sectorSize, &secsInTrack, &num));
+	numUnits = 0;
+	nextUnit = 0;
+	for (i = 0; i < USLOSS_DISK_UNITS; i++){
+		if ((swapDisks & (1 << i)) == 0){
+			continue;
+		}
+		// the slots are the same on every unit, so the units must be alike but for their size
+		assert(P1_SUCCESS == P2_DiskSize(i, &unitSize, &unitSecs, &num));
+		assert(numUnits == 0 || (unitSize == sectorSize && unitSecs == secsInTrack));
+		sectorSize = unitSize;
+		secsInTrack = unitSecs;
+		units[numUnits++] = i;
+		firstTrack[i] = tracks;
+		unitTracks[i] = num;
+		heads[i] = 0;
+		tracks += num;
+	}
 	int sectorInPage = size/sectorSize;
-	int space = (secsInTrack/sectorInPage) * num;
+	int space = (secsInTrack/sectorInPage) * tracks;
 	makeHoldList(space, sectorInPage, secsInTrack);
 
-	chooseF = malloc(sizeof(int)*frames);
-	makeFrameList(frames);
-	int i;
+	validF = malloc(sizeof(int)*frames);
 	for (i = 0; i < frames; i++){
-		chooseF[i] = 0;
+		validF[i] = FALSE;
 	}
+	assert(P1_SUCCESS == P1_SemCreate("swapLock", 1, &swapLock));
+	assert(P1_SUCCESS == P1_SemCreate("clockLock", 1, &clockLock));
+	assert(P1_SUCCESS == P1_SemCreate("swapIoDone", 0, &ioDone));
+	assert(P1_SUCCESS == P1_SemCreate("frameDone", 0, &frameDone));
+	for (i = 0; i < P1_MAXPROC; i++){
+		char name[P1_MAXNAME+1];
+		snprintf(name, sizeof(name), "%s%d", "table", i);
+		assert(P1_SUCCESS == P1_SemCreate(name, 1, &tableLocks[i]));
+	}
+	ioWaiters = 0;
+	frameWaiters = 0;
 	init = TRUE;
-	exclusive = NULL;
 	P3_vmStats.blocks = space;
 	P3_vmStats.freeBlocks = space;
 	P3_vmStats.freeFrames = frames;
@@ -206,53 +826,34 @@ P3SwapInit(int pages, int frames)
 }
 
 /*
- *Creates the name and creates the semaphore for the process
- *Returns the semaphore id.
-*/
-int create(int pid){
-	int sid;
-	char name[P1_MAXNAME+1];
-	snprintf(name, sizeof(name), "%s%d", "mutex", pid);
-	assert(P1_SUCCESS == P1_SemCreate(name, 1, &sid));
-	return sid;
-}
-
-/*
- *Goes through the linked list to find the semaphore for the process
- * if there is no node with a semaphore, one is created and added 
- * to the linked list, returns the semaphore id.
-*/
-int getSem(int pid){
-	struct Mutex *temp = NULL;
-	int sid = 0;
-	struct Mutex *prev = NULL;
-	if (exclusive == NULL){
-		sid = create( pid);
-		exclusive = malloc(sizeof(struct Mutex));
-		temp = exclusive;
-		temp ->sid =sid;
-		temp -> pid = pid;
-		temp ->next = NULL;
-	}else{// search for
-		temp = exclusive;
-		while (temp != NULL){
-			if (temp ->pid == pid){
-				return temp->sid;
-			}
-			prev = temp;
-			temp = temp ->next;
-		}
-
+ *----------------------------------------------------------------------
+ *
+ * P3SwapDisks --
+ *
+ *  Sets the disk units that hold swap space, bit i of disks for unit i.
+ *  Slots are placed on them
+ *  in turn so that pagers can use them in parallel. Must be called
+ *  before P3SwapInit.
+ *
+ * Results:
+ *   P3_ALREADY_INITIALIZED:    P3SwapInit has already been called
+ *   P3_INVALID_SWAP_DISKS:     disks is empty or names a unit that doesn't exist
+ *   P1_SUCCESS:                success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapDisks(int disks)
+{
+	check();
+	if (init){
+		return P3_ALREADY_INITIALIZED;
 	}
-	if (temp == NULL){
-		sid = create(pid);
-		prev -> next = malloc(sizeof(struct Mutex));
-		temp = prev->next;
-		temp ->next = NULL;
-		temp ->sid = sid;
-		temp ->pid = pid;
+	if ((disks <= 0) || (disks >= (1 << USLOSS_DISK_UNITS))){
+		return P3_INVALID_SWAP_DISKS;
 	}
-	return temp -> sid;
+	swapDisks = disks;
+	return P1_SUCCESS;
 }
 
 /*
@@ -278,28 +879,31 @@ P3SwapShutdown(void)
 		return P3_NOT_INITIALIZED;
 	}
 
-	free(chooseF);
-
-	struct InFrame* temp3;
-	while (temp3!=NULL){
-		temp3 = frames -> next;
-		free(frames);
-		frames = temp3;
+	assert(P1_SUCCESS == P1_SemFree(swapLock));
+	assert(P1_SUCCESS == P1_SemFree(clockLock));
+	assert(P1_SUCCESS == P1_SemFree(ioDone));
+	assert(P1_SUCCESS == P1_SemFree(frameDone));
+	int i;
+	for (i = 0; i < P1_MAXPROC; i++){
+		assert(P1_SUCCESS == P1_SemFree(tableLocks[i]));
 	}
-	
-	struct Hold* temp2;
-	while (swapSpace != NULL){
-		temp2 = swapSpace ->next;
-		free(swapSpace);
-		swapSpace = temp2;
+	free(validF);
+	for (i = 0; i < P1_MAXPROC; i++){
+		free(ioBuf[i]);
+		ioBuf[i] = NULL;
 	}
-
-	struct Mutex *temp;
-	while(exclusive !=NULL){
-		temp = exclusive ->next;
-		free(exclusive);
-		exclusive = temp;
+	for (i = 0; i < numSlots; i++){
+		uncache(i);
+		unfast(i);
 	}
+	free(swapSpace);
+	free(freeMap);
+	free(trackFree);
+	free(buckets);
+	swapSpace = NULL;
+	freeMap = NULL;
+	trackFree = NULL;
+	buckets = NULL;
 
     return result;
 }
@@ -328,160 +932,683 @@ P3SwapFreeAll(int pid)
 	}
     /*****************
 
-    P(mutex)
+    P(swapLock)
     free all swap space used by the process
-    V(mutex)
+    V(swapLock)
 
     *****************/
-	int mut = getSem(pid);
-	assert(P1_SUCCESS == P1_P(mut));
-	struct Hold* temp = swapSpace;
-	while(temp != NULL){
-		if (temp -> pid == pid){
-			temp -> pid = -1;
-			temp ->frame = -1;
-			temp -> page = -1;
-			temp -> room = 0;
-			//P3_vmStats.freeFrames++ ;
-			P3_vmStats.freeBlocks++;//
-		}
-		temp = temp ->next;
-	}
-	assert(P1_SUCCESS == P1_V(mut));
-
-    	return result;
-}
-
-/*
- *Searches for the node representing the frame being looked for.
- * Returns pointer to the node.
-*/
-struct InFrame *getFrame(int frame){
-	struct InFrame *temp = frames;
-	while (temp !=NULL){
-		if (temp -> frame == frame){
-			return temp;
+	assert(P1_SUCCESS == P1_P(swapLock));
+	int *map;
+	assert(P1_SUCCESS == P3SwapMapGet(pid, &map));
+	if (map != NULL){
+		int page;
+		for (page = 0; page < P3_vmStats.pages; page++){
+			// a slot can't be freed under a pager still writing it
+			while (map[page] != -1 && swapSpace[map[page]].io != IO_NONE){
+				waitIo();
+			}
+			if (map[page] != -1){
+				release(map[page]);
+				map[page] = -1;
+			}
 		}
-		temp = temp -> next;
 	}
-	return NULL;
+	assert(P1_SUCCESS == P1_V(swapLock));
 
+    	return result;
 }
 
-
 /*
  *----------------------------------------------------------------------
  *
- * P3SwapOut --
+ * P3SwapLockTable --
  *
- * Uses the clock algorithm to select a frame to replace, writing the page that is in the frame out 
- * to swap if it is dirty. The page table of the page’s process is modified so that the page no 
- * longer maps to the frame. The frame that was selected is returned in *frame. 
+ *  Locks a process's page table against the pagers, for the process
+ *  to free its frames and its page table when it quits.
  *
  * Results:
  *   P3_NOT_INITIALIZED:    P3SwapInit has not been called
+ *   P1_INVALID_PID:        pid is invalid
  *   P1_SUCCESS:            success
  *
  *----------------------------------------------------------------------
  */
 int
-P3SwapOut(int *frame) 
+P3SwapLockTable(int pid)
 {
 	check();
-    	int result = P1_SUCCESS;
 	if (!init){
 		return P3_NOT_INITIALIZED;
 	}
+	if ((pid < 0) || (pid >= P1_MAXPROC)){
+		return P1_INVALID_PID;
+	}
+	assert(P1_SUCCESS == P1_P(tableLocks[pid]));
+	return P1_SUCCESS;
+}
 
-
-	static int hand = -1;
-	int pid = P1_GetPid();
-	int mut = getSem(pid);
-	int target;
-
-	assert(P1_SUCCESS== P1_P(mut));	
-
-	int frames = P3_vmStats.frames;
-	int access = 0;
-	while(TRUE){
-		hand = (hand+1)%frames;
-		if (chooseF[hand] == 0){ // if not busy
-			assert(P1_SUCCESS == USLOSS_MmuGetAccess(hand, &access));
-			if ( (access &USLOSS_MMU_REF) == 0){// if not referenced
-				target = hand;
-				break;
-			}else{
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapUnlockTable --
+ *
+ *  Opposite of P3SwapLockTable.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3SwapInit has not been called
+ *   P1_INVALID_PID:        pid is invalid
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapUnlockTable(int pid)
+{
+	check();
+	if (!init){
+		return P3_NOT_INITIALIZED;
+	}
+	if ((pid < 0) || (pid >= P1_MAXPROC)){
+		return P1_INVALID_PID;
+	}
+	assert(P1_SUCCESS == P1_V(tableLocks[pid]));
+	return P1_SUCCESS;
+}
+
+/*
+ *Returns TRUE if some frame is busy. Called with clockLock.
+*/
+static int anyBusy(void){
+	P3FrameInfo *info;
+	int i;
+	for (i = 0; i < P3_vmStats.frames; i++){
+		assert(P1_SUCCESS == P3FrameInfoGet(i, &info));
+		if (info->busy){
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ *Runs the clock algorithm until count frames have been chosen. If limit is not
+ * zero the hand gives up after going around limit times. Chosen frames are
+ * marked busy. Called with clockLock. Returns the number of frames chosen.
+*/
+static int sweep(int count, int *chosen, int limit){
+	int frames = P3_vmStats.frames;
+	int found = 0;
+	int steps = 0;
+	int bits;
+	P3FrameInfo *info;
+	while (found < count && (limit == 0 || steps < limit * frames)){
+		hand = (hand+1)%frames;
+		steps++;
+		assert(P1_SUCCESS == P3FrameInfoGet(hand, &info));
+		if (!info->busy && info->pid != -1){ // if not busy and not free
+			assert(P1_SUCCESS == USLOSS_MmuGetAccess(hand, &bits));
+			if ( (bits &USLOSS_MMU_REF) == 0){// if not referenced
+				info->busy = TRUE;
+				chosen[found] = hand;
+				found++;
+			}else{
 				// clear reference bit, USLOSS_MmuSetAccess
-				assert(P1_SUCCESS ==  USLOSS_MmuSetAccess(hand,access&USLOSS_MMU_DIRTY)); 
+				assert(P1_SUCCESS ==  USLOSS_MmuSetAccess(hand,bits&USLOSS_MMU_DIRTY)); 
 			}
 		}
 	}
+	return found;
+}
+
+/*
+ *Removes the mapping of the page in the frame from the owner's page table.
+ * Called with the owner's tableLock.
+*/
+static void unmap(P3FrameInfo *info){
+	USLOSS_PTE *pte;
+	assert(P1_SUCCESS ==P3PageTableGet(info->pid, &pte));
+	if (pte != NULL){
+		pte[info->page].incore =FALSE;
+		pte[info->page].frame = -1;
+		assert(P1_SUCCESS == USLOSS_MmuSetPageTable(pte));
+	}
+}
+
+/*
+ *Opposite of unmap, for a page that stays in memory after all.
+*/
+static void remap(int target, P3FrameInfo *info){
+	USLOSS_PTE *pte;
+	assert(P1_SUCCESS ==P3PageTableGet(info->pid, &pte));
+	if (pte != NULL){
+		pte[info->page].frame = target;
+		pte[info->page].incore = TRUE;
+		assert(P1_SUCCESS == USLOSS_MmuSetPageTable(pte));
+	}
+}
 
-	if ((access& USLOSS_MMU_DIRTY) == 2){
-		// write page to its location on the swap disk
-		struct Hold *temp = swapSpace;
-		struct InFrame *temp2 = getFrame(target);
-		while (temp != NULL){
-			if (temp -> pid == temp2->pid && temp -> page == temp2->page){
-				break;
+/*
+ *Clears the descriptor of a frame whose page has been evicted.
+*/
+static void forget(int target){
+	P3FrameInfo *info;
+	assert(P1_SUCCESS == P3FrameInfoGet(target, &info));
+	info->pid = -1;
+	info->page = -1;
+	info->slot = -1;
+	validF[target] = FALSE;
+}
+
+/*
+ *Returns TRUE if the page in the frame has to be written back before it is
+ * evicted, i.e. it was written or its swap copy is otherwise stale. A clean page
+ * is counted as dropped without I/O.
+*/
+static int mustWrite(int target, int access){
+	if ((access & USLOSS_MMU_DIRTY) || !validF[target]){
+		return TRUE;
+	}
+	P3_vmStats.cleanDrops++;
+	return FALSE;
+}
+
+/*
+ *Evicts the pages in the victim frames. Each page is unmapped under its
+ * tableLock before its dirty bit is read. Clean pages are dropped, dirty ones
+ * are copied to the buffer and go to a zero slot, a shared slot, the fast tier,
+ * the cache or the disk, in that order of preference. Disk pages are moved to
+ * one run of slots when they can be, and their writes are set up in ios for
+ * flush. A page that needs a slot when there is none is mapped again and
+ * marked in kept. Called with swapLock. Returns the number of pages kept.
+*/
+static int writeOut(int count, int *victims, int *kept, struct Io *ios, int *numIos){
+	P3FrameInfo *info;
+	int *map;
+	int first = -1;
+	int disk[CLUSTER];	// slots of the pages that go to disk, in order in buffer
+	int diskPid[CLUSTER];	// their processes
+	int diskPage[CLUSTER];	// and pages
+	unsigned int hashes[CLUSTER];
+	int numDisk = 0;
+	int numKept = 0;
+	int access;
+	int i;
+	char *buffer = getBuf();
+	char *scratch = buffer + CLUSTER * size;
+	void *address;
+	assert(count <= CLUSTER);
+	*numIos = 0;
+	for (i = 0; i < count; i++){
+		kept[i] = FALSE;
+		assert(P1_SUCCESS == P3FrameInfoGet(victims[i], &info));
+		// a slot the page has to itself may still be on its way to or from the
+		// disk, e.g. a demoted copy it shared until now, wait before reusing it
+		while (info->slot != -1 && swapSpace[info->slot].refs == 1 &&
+		    swapSpace[info->slot].io != IO_NONE){
+			waitIo();
+		}
+		int pid = info->pid;
+		if (pid == -1){
+			// its process quit after the clock chose it, the frame is free
+			continue;
+		}
+		assert(P1_SUCCESS == P1_P(tableLocks[pid]));
+		if (info->pid != pid){
+			// its process quit while we waited for the lock
+			assert(P1_SUCCESS == P1_V(tableLocks[pid]));
+			continue;
+		}
+		unmap(info);
+		// the process can't touch the page now, so its dirty bit is final
+		assert(P1_SUCCESS == USLOSS_MmuGetAccess(victims[i], &access));
+		if (access & USLOSS_MMU_DIRTY){
+			validF[victims[i]] = FALSE; // the process wrote the page
+		}
+		if (!mustWrite(victims[i], access)){
+			assert(P1_SUCCESS == P1_V(tableLocks[pid]));
+			continue;
+		}
+		assert(P1_SUCCESS == P3SwapMapGet(info->pid, &map));
+		char *page = buffer + numDisk * size;
+		assert(P1_SUCCESS == P3FrameMap(victims[i], &address));
+		int zero = isZero(address);
+		if (!zero){
+			memcpy(page, address, size);
+		}
+		assert(P1_SUCCESS == P3FrameUnmap(victims[i]));
+		int own = (info->slot != -1 && swapSpace[info->slot].refs == 1);
+		if (zero && !own){
+			// without a slot the page reads back as a new, all zero page
+			if (info->slot != -1){
+				release(info->slot);
+				map[info->page] = -1;
+				info->slot = -1;
+			}
+		}else if (!own){
+			int slot = allocSlot(info->pid, info->page, map);
+			if (slot == -1){
+				// out of swap, the page stays in memory
+				remap(victims[i], info);
+				assert(P1_SUCCESS == P1_V(tableLocks[pid]));
+				kept[i] = TRUE;
+				numKept++;
+				continue;
 			}
-			temp = temp -> next;
-		}
-		void *address;
-		int rc = P3FrameMap(target, &address);
-		void *buffer = malloc(size);
-		memcpy(buffer, address, size);
-		assert(P1_SUCCESS == P2_DiskWrite(P3_SWAP_DISK, temp->track, temp->start, temp->total,buffer));
-		free(buffer);
-		rc = P3FrameUnmap(target);
-		
+			if (info->slot != -1){
+				// it was sharing a copy
+				swapSpace[info->slot].refs--;
+				swapSpace[slot].refaults = swapSpace[info->slot].refaults;
+				P3_vmStats.shared--;
+			}
+			info->slot = slot;
+		}
 		// clear dirt bit USLOSS_MmuSetAccess
-		assert(P1_SUCCESS == USLOSS_MmuSetAccess(target, access&USLOSS_MMU_REF));
+		assert(P1_SUCCESS == USLOSS_MmuSetAccess(victims[i], access&USLOSS_MMU_REF));
+		// the process may quit once the lock is released, which clears info
+		int slot = info->slot;
+		int vpage = info->page;
+		assert(P1_SUCCESS == P1_V(tableLocks[pid]));
+		P3_vmStats.zeroPages += zero;
+		if (slot == -1){
+			continue;
+		}
+		unhash(slot); // the copy is about to change
+		uncache(slot);
+		unfast(slot);
+		swapSpace[slot].zero = zero;
+		if (zero){
+			continue;
+		}
+		// until it is stored the copy is only in buffer, a fault on the page waits
+		swapSpace[slot].io = IO_WRITE;
+		hashes[numDisk] = hashPage((unsigned char *) page);
+		int dup = findDup(hashes[numDisk], page, scratch);
+		if (dup != -1){
+			if (swapSpace[slot].refaults > swapSpace[dup].refaults){
+				swapSpace[dup].refaults = swapSpace[slot].refaults;
+			}
+			freeSlot(slot);
+			swapSpace[dup].refs++;
+			map[vpage] = dup;
+			P3_vmStats.shared++;
+			P3_vmStats.dedupHits++;
+		}else if (swapSpace[slot].refaults >= HOT &&
+		    fastStore(slot, page, FALSE, ios, numIos)){
+			// it keeps coming back, keep it in the fast tier
+			swapSpace[slot].io = IO_NONE;
+			hashAdd(slot, hashes[numDisk]);
+			P3_vmStats.fastOuts++;
+		}else if (cacheStore(slot, page)){
+			swapSpace[slot].io = IO_NONE;
+			hashAdd(slot, hashes[numDisk]);
+		}else{
+			disk[numDisk] = slot;
+			diskPid[numDisk] = pid;
+			diskPage[numDisk] = vpage;
+			numDisk++;
+		}
 	}
-	
-	USLOSS_PTE *pte;
-	struct Hold *temp = swapSpace;
-	while (temp != NULL){
-		if (temp -> frame == target){
-			int found = temp -> pid;
-			assert(P1_SUCCESS ==P3PageTableGet(found, &pte));
-			int i;
-			for (i = 0;i< P3_vmStats.pages; i++){
-				if (pte[i].frame == target){
-					pte[i].incore =FALSE;
-					pte[i].frame = -1;
-				}
+
+	if (numDisk > 1){
+		// the victims' own slots may be part of the run
+		int refaults[CLUSTER];	// the pages keep their refault counts when they move
+		for (i = 0; i < numDisk; i++){
+			refaults[i] = swapSpace[disk[i]].refaults;
+			freeSlot(disk[i]);
+		}
+		first = placeRun(numDisk);
+		for (i = 0; i < numDisk; i++){
+			assert(P1_SUCCESS == P3SwapMapGet(diskPid[i], &map));
+			if (first != -1){
+				disk[i] = first + i;
 			}
+			takeSlot(disk[i], diskPid[i], diskPage[i], map);
+			swapSpace[disk[i]].refaults = refaults[i];
+		}
+	}
+	for (i = 0; i < numDisk; i++){
+		swapSpace[disk[i]].io = IO_WRITE;
+		swapSpace[disk[i]].hash = hashes[i];
+		if (first == -1){
+			ios[*numIos].slot = disk[i];
+			ios[*numIos].count = 1;
+			ios[*numIos].buf = buffer + i * size;
+			ios[*numIos].owned = FALSE;
+			(*numIos)++;
 		}
-		temp = temp->next;
 	}
+	if (first != -1){
+		ios[*numIos].slot = first;
+		ios[*numIos].count = numDisk;
+		ios[*numIos].buf = buffer;
+		ios[*numIos].owned = FALSE;
+		(*numIos)++;
+	}
+	for (i = 0; i < count; i++){
+		if (!kept[i]){
+			forget(victims[i]);
+		}
+	}
+	P3_vmStats.pageOuts += numDisk;
+	// the copies that didn't go to disk are stored, those waiting for them look again
+	wakeIo();
+	return numKept;
+}
 
-	assert(P1_SUCCESS == USLOSS_MmuSetPageTable(pte));
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapOut --
+ *
+ * Uses the clock algorithm to select a frame to replace, writing the page that is in the frame out 
+ * to swap if it is dirty or its swap copy is not valid. The page table of the page’s process is modified so that the page no 
+ * longer maps to the frame. The frame that was selected is returned in *frame. 
+ *
+ * A page is given swap space the first time it is written out. If a page needs
+ * swap space and there is none it stays in memory and the clock moves on.
+ *
+ * The clock goes around at most twice while holding clockLock. If it finds
+ * nothing because every frame in use is busy, it waits for a pager to be done
+ * with one (P3SwapDone) and tries again. If no frame is in use at all *frame
+ * is set to -1, the caller should take one from the free pool.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3SwapInit has not been called
+ *   P3_OUT_OF_SWAP:        every page the clock tried needed swap space and there is none
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapOut(int *frame) 
+{
+	check();
+    	int result = P1_SUCCESS;
+	if (!init){
+		return P3_NOT_INITIALIZED;
+	}
 
+	int target;
+	int kept;
+	int tries = 0;
+	P3FrameInfo *info;
+	struct Io ios[2 * CLUSTER];	// a disk write and a demotion per page at most
+	int numIos = 0;
+
+	while (TRUE){
+		assert(P1_SUCCESS == P1_P(clockLock));
+		while (sweep(1, &target, 2) == 0){
+			if (!anyBusy()){
+				// every frame is free, there is nothing to evict
+				assert(P1_SUCCESS == P1_V(clockLock));
+				*frame = -1;
+				return result;
+			}
+			// the rest are busy, wait for a pager to be done with one
+			waitFrame();
+		}
+		assert(P1_SUCCESS == P1_V(clockLock));
+		assert(P1_SUCCESS== P1_P(swapLock));	
+		if (writeOut(1, &target, &kept, ios, &numIos) == 0){
+			flush(ios, numIos);
+			assert(P1_SUCCESS == P1_V(swapLock)); 	
+			*frame = target;
+			break;
+		}
+		assert(P1_SUCCESS == P1_V(swapLock)); 	
+		// the page needs swap space and there is none, try another one
+		assert(P1_SUCCESS == P3FrameInfoGet(target, &info));
+		assert(P1_SUCCESS == P1_P(clockLock));
+		if (info->pid == -1){
+			// unless its process has quit since, which leaves the frame free
+			assert(P1_SUCCESS == P1_V(clockLock));
+			*frame = target;
+			break;
+		}
+		info->busy = FALSE;
+		wakeFrame();
+		assert(P1_SUCCESS == P1_V(clockLock));
+		tries++;
+		if (tries == P3_vmStats.frames){
+			result = P3_OUT_OF_SWAP;
+			break;
+		}
+	}
+
+
+    	return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapOutBatch --
+ *
+ * Like P3SwapOut, but chooses up to count frames in one sweep of the clock.
+ * The sweep goes around at most twice, so fewer frames may be chosen. They
+ * are evicted CLUSTER at a time, so the dirty pages of a group can go out in
+ * one disk request. Pages that need swap space when there is none stay in
+ * memory. The frames are returned in frames and their number in *chosen.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3SwapInit has not been called
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapOutBatch(int count, int *frames, int *chosen)
+{
+	check();
+    	int result = P1_SUCCESS;
+	if (!init){
+		return P3_NOT_INITIALIZED;
+	}
 
-	chooseF[target] = 1; // frame is busy	
-	P3_vmStats.pageOuts++;
-	assert(P1_SUCCESS == P1_V(mut)); 	
-	*frame = target;
+	int keep[count];
+	struct Io ios[2 * CLUSTER];	// a disk write and a demotion per page at most
+	int numIos;
 
+	assert(P1_SUCCESS == P1_P(clockLock));
+	*chosen = sweep(count, frames, 2);
+	assert(P1_SUCCESS == P1_V(clockLock));
+	assert(P1_SUCCESS== P1_P(swapLock));	
+	int i;
+	// the buffer holds one cluster, so each is written before the next is set up
+	for (i = 0; i < *chosen; i += CLUSTER){
+		int n = (*chosen - i < CLUSTER) ? *chosen - i : CLUSTER;
+		writeOut(n, frames + i, keep + i, ios, &numIos);
+		flush(ios, numIos);
+	}
+	assert(P1_SUCCESS == P1_V(swapLock)); 	
+	// frames whose pages couldn't get swap space stay in memory, unless the
+	// process has quit since, which leaves the frame free
+	int n = 0;
+	P3FrameInfo *info;
+	assert(P1_SUCCESS == P1_P(clockLock));
+	for (i = 0; i < *chosen; i++){
+		assert(P1_SUCCESS == P3FrameInfoGet(frames[i], &info));
+		if (keep[i] && info->pid != -1){
+			info->busy = FALSE;
+			wakeFrame();
+		}else{
+			frames[n++] = frames[i];
+		}
+	}
+	assert(P1_SUCCESS == P1_V(clockLock));
+	*chosen = n;
 
     	return result;
 }
 
 /*
- *Looks for the swapSpace being used by the given process and page.
- * If not there then returns Null, else returns pointer to the node.
+ *Gets spare frames for the pages after page that are on the next slots of the
+ * same track, not in memory and not being written, stopping at the first one that isn't or when
+ * the free pool runs low. Returns the number of frames put in extra.
 */
-struct Hold * getSpace(int pid, int page){
-	struct Hold *temp = swapSpace;
-	while (temp != NULL){
-		if ((temp -> room == 1) && (temp -> pid == pid) && (temp->page == page)){
-			return temp; // found it
+static int gather(int pid, int page, int slot, int *map, int *extra){
+	USLOSS_PTE *pte;
+	int n = 0;
+	assert(P1_SUCCESS == P1_P(tableLocks[pid]));
+	assert(P1_SUCCESS == P3PageTableGet(pid, &pte));
+	while (n < readAhead){
+		int next = page + n + 1;
+		int nextSlot = slot + n + 1;
+		if (next >= P3_vmStats.pages || nextSlot >= numSlots || map[next] != nextSlot ||
+		    swapSpace[nextSlot].start == 0 || swapSpace[nextSlot].cached != NULL || swapSpace[nextSlot].fast != NULL || swapSpace[nextSlot].zero ||
+		    swapSpace[nextSlot].io != IO_NONE || pte[next].incore){
+			break;
 		}
-		temp = temp -> next;
+		assert(P1_SUCCESS == P3FrameSpare(&extra[n]));
+		if (extra[n] == -1){
+			break;
+		}
+		n++;
+	}
+	assert(P1_SUCCESS == P1_V(tableLocks[pid]));
+	return n;
+}
+
+/*
+ *Maps a page that was read ahead into the process's page table. The frame is
+ * marked clean and unreferenced so the clock takes it first if it isn't used.
+ * It stays busy until P3SwapIn has released swapLock. The faulting page is
+ * mapped right after this, which reloads the table.
+*/
+static void install(int pid, int page, int slot, int frame){
+	USLOSS_PTE *pte;
+	P3FrameInfo *info;
+	assert(P1_SUCCESS == P3FrameInfoGet(frame, &info));
+	info->pid = pid;
+	info->page = page;
+	info->slot = slot;
+	validF[frame] = TRUE;
+	assert(P1_SUCCESS == USLOSS_MmuSetAccess(frame, 0));
+	assert(P1_SUCCESS == P1_P(tableLocks[pid]));
+	assert(P1_SUCCESS == P3PageTableGet(pid, &pte));
+	pte[page].frame = frame;
+	pte[page].read = TRUE;
+	pte[page].write = TRUE;
+	pte[page].incore = TRUE;
+	assert(P1_SUCCESS == P1_V(tableLocks[pid]));
+	P3_vmStats.prefetched++;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapReadAhead --
+ *
+ *  Sets the number of pages read ahead of a page brought in from swap.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P3_INVALID_READ_AHEAD:  window is negative or too big
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapReadAhead(int window)
+{
+	check();
+	if (!init){
+		return P3_NOT_INITIALIZED;
+	}
+	if ((window < 0) || (window > P3_MAX_READ_AHEAD)){
+		return P3_INVALID_READ_AHEAD;
+	}
+	readAhead = window;
+	return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapCacheSize --
+ *
+ *  Sizes the compressed swap cache as a percentage of physical memory.
+ *  0 turns it off.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P3_INVALID_CACHE_SIZE:  percent is not between 0 and 100
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapCacheSize(int percent)
+{
+	check();
+	if (!init){
+		return P3_NOT_INITIALIZED;
+	}
+	if ((percent < 0) || (percent > 100)){
+		return P3_INVALID_CACHE_SIZE;
 	}
+	cacheLimit = P3_vmStats.frames * size / 100 * percent;
+	return P1_SUCCESS;
+}
 
-	return temp;
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapFastSize --
+ *
+ *  Sizes the fast swap tier, a RAM-backed area in front of the swap
+ *  disks for pages that refault often. 0 turns it off.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P3_INVALID_FAST_SIZE:   pages is negative
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapFastSize(int pages)
+{
+	check();
+	if (!init){
+		return P3_NOT_INITIALIZED;
+	}
+	if (pages < 0){
+		return P3_INVALID_FAST_SIZE;
+	}
+	fastLimit = pages;
+	return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapBufFree --
+ *
+ *  Frees the disk buffer of a pager that is retiring, so that it
+ *  isn't kept until shutdown. The pager must have no swap I/O in
+ *  progress.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapBufFree(int pid)
+{
+	check();
+	if (!init){
+		return P3_NOT_INITIALIZED;
+	}
+	if ((pid < 0) || (pid >= P1_MAXPROC)){
+		return P1_INVALID_PID;
+	}
+	free(ioBuf[pid]);
+	ioBuf[pid] = NULL;
+	return P1_SUCCESS;
 }
 
 /*
@@ -489,7 +1616,12 @@ struct Hold * getSpace(int pid, int page){
  *
  * P3SwapIn --
  *
- *  Opposite of P3FrameMap. The frame is unmapped.
+ *  Opposite of P3FrameMap. The frame is unmapped. It stays busy until
+ *  the caller has mapped the page and calls P3SwapDone. If read-ahead
+ *  is on, the process's following pages in the following swap slots are
+ *  read in by the same request and mapped into spare frames. A page read
+ *  from disk that has come back HOT times is also copied into the fast
+ *  swap tier.
  *
  * Results:
  *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
@@ -497,7 +1629,6 @@ struct Hold * getSpace(int pid, int page){
  *   P1_INVALID_PAGE:        page is invalid         
  *   P1_INVALID_FRAME:       frame is invalid
  *   P3_EMPTY_PAGE:          page is not in swap
- *   P1_OUT_OF_SWAP:         there is no more swap space
  *   P1_SUCCESS:             success
  *
  *----------------------------------------------------------------------
@@ -523,47 +1654,142 @@ P3SwapIn(int pid, int page, int frame)
 
 
 	void *address;
-	int mut = getSem(pid);
-	assert (P1_SUCCESS == P1_P(mut));		
-	struct InFrame *temp = getFrame(frame);
-	temp -> pid = pid;
-	temp ->page = page;
-
-	struct Hold *space = getSpace(pid, page);
-	if (space!= NULL){  // if on disk reading into frame
-		space ->frame = frame;
+	P3FrameInfo *info;
+	assert(P1_SUCCESS == P3FrameInfoGet(frame, &info));
+	assert(P1_SUCCESS == P1_P(clockLock));
+	info->busy = TRUE; // busy until it is filled
+	assert(P1_SUCCESS == P1_V(clockLock));
+	assert (P1_SUCCESS == P1_P(swapLock));		
+	info -> pid = pid;
+	info -> page = page;
+	info -> slot = -1;
+
+	int *map;
+	int extra[P3_MAX_READ_AHEAD];	// frames of the pages read ahead
+	int n = 0;
+	int i;
+	assert(P1_SUCCESS == P3SwapMapGet(pid, &map));
+	assert(map != NULL);
+	// the page may still be on its way out, wait for that rather than read a partial copy
+	while (map[page] != -1 && swapSpace[map[page]].io != IO_NONE){
+		waitIo();
+	}
+	int slot = map[page];
+	int valid = TRUE;
+	if (slot != -1){
+		swapSpace[slot].refaults++;
+	}
+	if (slot != -1 && swapSpace[slot].zero){
+		// the page was all zeros when it was swapped out
+		info -> slot = slot;
 		assert(P1_SUCCESS== P3FrameMap(frame, &address));
-		char * buffer = malloc(size);
-		assert (P1_SUCCESS == P2_DiskRead(P3_SWAP_DISK, space->track, space->start, space->total, buffer));
-		memcpy(address, buffer, size);
-		free(buffer);
+		memset(address, 0, size);
 		assert(P1_SUCCESS == P3FrameUnmap(frame));
 		P3_vmStats.pageIns++;
-	}else{
-		// allocate space for page on swap disk
-		struct Hold *temp = swapSpace;
-		while (temp !=NULL){
-			if (temp -> room ==0){
-				temp -> pid = pid;
-				temp -> page = page;
-				temp -> frame = frame;
-				temp -> room = 1; // occupied
-				break;
-			}
-			temp = temp -> next;
+	}else if (slot != -1 && swapSpace[slot].fast != NULL){
+		// the page is in the fast swap tier
+		struct Hold *space = &swapSpace[slot];
+		info -> slot = slot;
+		assert(P1_SUCCESS== P3FrameMap(frame, &address));
+		memcpy(address, space->fast, size);
+		assert(P1_SUCCESS == P3FrameUnmap(frame));
+		fastUnlink(slot);
+		fastLink(slot); // it is the hottest now
+		if (!space->slow && space->refs == 1){
+			// the page takes the only copy with it and is written back when evicted
+			unhash(slot);
+			unfast(slot);
+			valid = FALSE;
 		}
-
-		if (temp == NULL){
-		// out of space
-			result = P3_OUT_OF_SWAP;
-		}else{
-			result = P3_EMPTY_PAGE;
+		P3_vmStats.fastIns++;
+		P3_vmStats.pageIns++;
+	}else if (slot != -1 && swapSpace[slot].cached != NULL){
+		// the page is in the compressed swap cache
+		info -> slot = slot;
+		assert(P1_SUCCESS== P3FrameMap(frame, &address));
+		unpack(swapSpace[slot].cached, swapSpace[slot].cachedLen, address);
+		assert(P1_SUCCESS == P3FrameUnmap(frame));
+		P3_vmStats.cacheHits++;
+		P3_vmStats.pageIns++;
+	}else if (slot != -1){  // if on disk reading into frame
+		struct Hold *space = &swapSpace[slot];
+		n = gather(pid, page, slot, map, extra);
+		info -> slot = slot;
+		char *buffer = getBuf();
+		for (i = 0; i <= n; i++){
+			swapSpace[slot + i].io = IO_READ;
+		}
+		// the following slots are on the same track so one request reads them all
+		seek(space->unit, space->track);
+		assert(P1_SUCCESS == P1_V(swapLock));
+		assert (P1_SUCCESS == P2_DiskRead(space->unit, space->track, space->start, space->total * (n + 1), buffer));
+		assert(P1_SUCCESS == P1_P(swapLock));
+		for (i = 0; i <= n; i++){
+			swapSpace[slot + i].io = IO_NONE;
 		}
-		P3_vmStats.freeBlocks--;
+		wakeIo();
+		assert(P1_SUCCESS== P3FrameMap(frame, &address));
+		memcpy(address, buffer, size);
+		assert(P1_SUCCESS == P3FrameUnmap(frame));
+		if (space->refaults >= HOT && fastStore(slot, buffer, TRUE, NULL, NULL)){
+			// it keeps coming back, the next refault is served from the fast tier
+			P3_vmStats.promoted++;
+		}
+		for (i = 0; i < n; i++){
+			assert(P1_SUCCESS== P3FrameMap(extra[i], &address));
+			memcpy(address, buffer + (i + 1) * size, size);
+			assert(P1_SUCCESS == P3FrameUnmap(extra[i]));
+			install(pid, page + i + 1, slot + i + 1, extra[i]);
+		}
+		P3_vmStats.slowIns++;
+		P3_vmStats.pageIns++;
+	}else{
+		// a new page, it gets swap space when it is first written out
+		result = P3_EMPTY_PAGE;
+	}
+	validF[frame] = valid;
+	assert(P1_SUCCESS == P1_V(swapLock));
+	// the pages read ahead are mapped, the clock may choose their frames now
+	for (i = 0; i < n; i++){
+		assert(P1_SUCCESS == P3SwapDone(extra[i]));
 	}
-	chooseF[frame] = 0;// not busy
-
-	assert(P1_SUCCESS == P1_V(mut));
 
     	return result;
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapDone --
+ *
+ *  Called when the caller is done with a frame it got from P3SwapIn,
+ *  P3SwapOut or P3SwapOutBatch: the page in it has been mapped into
+ *  its process's page table, or the frame has been put back in the
+ *  free pool. The frame is no longer busy, and pagers waiting for
+ *  the clock to have something to choose are woken.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_FRAME:       frame is invalid
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapDone(int frame)
+{
+	check();
+	if (!init){
+		return P3_NOT_INITIALIZED;
+	}
+	if ((frame < 0 ) || (frame >= P3_vmStats.frames)){
+		return P3_INVALID_FRAME;
+	}
+	P3FrameInfo *info;
+	assert(P1_SUCCESS == P3FrameInfoGet(frame, &info));
+	assert(P1_SUCCESS == P1_P(clockLock));
+	info->busy = FALSE;
+	wakeFrame();
+	assert(P1_SUCCESS == P1_V(clockLock));
+	return P1_SUCCESS;
+}
@@ -0,0 +1,79 @@
+/*
+ * test_cluster.c
+ * Clustered page-outs. 1 Swapper with 2 pages, then 8 children with 1
+ * page each, 8 frames, 2 pagers.
+ * The Swapper writes its 2 pages and waits. The children fault at once
+ * and sleep while holding their frames. Pager 1 steals 4 of their faults
+ * and takes 4 of the 6 free frames. Pager 0 gets the last 2 and has to
+ * evict 2 pages for the rest of its batch. The clock picks the Swapper's
+ * dirty pages, which go out together in one write. The Swapper then
+ * reads them back, one disk read each.
+ * 2 pageOuts, 3 diskOps, 2 page-ins, 12 faults.
+ */
+
+#define CHILDREN 8
+#define PAGES 2         // # of pages
+#define FRAMES CHILDREN
+#define PAGERS 2        // # of pagers
+
+#include "vmtest.h"
+
+static void
+WriteAll(int id)
+{
+    WritePages(id, 0, PAGES);
+}
+
+static void
+CheckAll(int id)
+{
+    CheckPages(id, 0, PAGES);
+}
+
+static int
+Child(void *arg)
+{
+    int     id = (int) arg;
+
+    WritePages(id, 0, 1);
+    Sys_Sleep(1);
+    CheckPages(id, 0, 1);
+    Sys_Terminate(1);
+    return 0;
+}
+
+static int
+Main(void *arg)
+{
+    Write(1, WriteAll, CheckAll);
+    Together(CHILDREN, Child);
+    TEST(P3_vmStats.pageOuts, PAGES);
+    TEST(P3_vmStats.diskOps, 1);
+    Read();
+    Finish();
+    Sys_Terminate(1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    Debug("P4_Startup starting.\n");
+    Run(Main);
+    P3_PrintStats(&P3_vmStats);
+    TEST(P3_vmStats.pageOuts, PAGES);
+    TEST(P3_vmStats.diskOps, 3);
+    TEST(P3_vmStats.pageIns, PAGES);
+    TEST(P3_vmStats.faults, PAGES + CHILDREN + PAGES);
+    TEST(P3_vmStats.stolen, CHILDREN / 2);
+    TEST(P3_vmStats.spawned, 1);
+    PASSED();
+    Sys_VmShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, CHILDREN);
+    assert(rc == 0);
+}
@@ -0,0 +1,69 @@
+/*
+ * test_dedup.c
+ * Swap deduplication. 8 Swappers with 2 pages each, 16 frames, 2 pagers.
+ * Every Swapper writes the same message on both of its pages. The hog
+ * evicts the first page to the disk. Each of the other 15 has the same
+ * hash, so the copy on the disk is read back and compared, and the page
+ * shares its slot instead of being written. All 16 pages are read back
+ * from that one slot.
+ * 15 dedupHits, 1 pageOut, 16 + 16 diskOps, 16 page-ins, 48 faults.
+ */
+
+#define SWAPPERS 8
+#define PAGES 16        // # of pages
+#define FRAMES 16
+#define PAGERS 2        // # of pagers
+#define MESSAGE "Every page is the same"
+
+#include "vmtest.h"
+
+static void
+WriteSame(int id)
+{
+    strcpy(Page(0), MESSAGE);
+    strcpy(Page(1), MESSAGE);
+}
+
+static void
+CheckSame(int id)
+{
+    TEST(strcmp(Page(0), MESSAGE), 0);
+    TEST(strcmp(Page(1), MESSAGE), 0);
+}
+
+static int
+Main(void *arg)
+{
+    Write(SWAPPERS, WriteSame, CheckSame);
+    Evict();
+    TEST(P3_vmStats.dedupHits, 2 * SWAPPERS - 1);
+    TEST(P3_vmStats.shared, 2 * SWAPPERS - 1);
+    TEST(P3_vmStats.pageOuts, 1);
+    TEST(P3_vmStats.diskOps, 2 * SWAPPERS);
+    Read();
+    Finish();
+    Sys_Terminate(1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    Debug("P4_Startup starting.\n");
+    Run(Main);
+    P3_PrintStats(&P3_vmStats);
+    TEST(P3_vmStats.dedupHits, 2 * SWAPPERS - 1);
+    TEST(P3_vmStats.pageOuts, 1);
+    TEST(P3_vmStats.pageIns, 2 * SWAPPERS);
+    TEST(P3_vmStats.diskOps, 4 * SWAPPERS);
+    TEST(P3_vmStats.faults, 2 * SWAPPERS + FRAMES + 2 * SWAPPERS);
+    PASSED();
+    Sys_VmShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, 20);
+    assert(rc == 0);
+}
@@ -0,0 +1,72 @@
+/*
+ * test_fast_swap.c
+ * Fast swap tier. 8 Swappers with 2 pages each, 16 frames, 2 pagers, a
+ * fast tier of 16 pages, 3 rounds of eviction and page-in.
+ * Round 1 writes the pages to the disk and reads them back. Round 2
+ * drops them, since they match their disk copies, and reads them from
+ * the disk again. That is their second refault, so they are hot and are
+ * copied up to the fast tier. Round 3 drops them again and reads them
+ * from the fast tier.
+ * 16 pageOuts, 32 cleanDrops, 32 slowIns, 16 promoted, 16 fastIns,
+ * 112 faults.
+ */
+
+#define SWAPPERS 8
+#define PAGES 16        // # of pages
+#define FRAMES 16
+#define PAGERS 2        // # of pagers
+#define FAST 16         // # of pages in the fast tier
+#define ROUNDS 3
+
+#include "vmtest.h"
+
+static void
+WriteTwo(int id)
+{
+    WritePages(id, 0, 2);
+}
+
+static void
+CheckTwo(int id)
+{
+    CheckPages(id, 0, 2);
+}
+
+static int
+Main(void *arg)
+{
+    Write(SWAPPERS, WriteTwo, CheckTwo);
+    for (int i = 0; i < ROUNDS; i++) {
+        Evict();
+        Read();
+    }
+    Finish();
+    Sys_Terminate(1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    Debug("P4_Startup starting.\n");
+    Run(Main);
+    P3_PrintStats(&P3_vmStats);
+    TEST(P3_vmStats.pageOuts, 2 * SWAPPERS);
+    TEST(P3_vmStats.cleanDrops, 4 * SWAPPERS);
+    TEST(P3_vmStats.slowIns, 4 * SWAPPERS);
+    TEST(P3_vmStats.promoted, 2 * SWAPPERS);
+    TEST(P3_vmStats.fastIns, 2 * SWAPPERS);
+    TEST(P3_vmStats.pageIns, 6 * SWAPPERS);
+    TEST(P3_vmStats.faults, 2 * SWAPPERS + ROUNDS * (FRAMES + 2 * SWAPPERS));
+    PASSED();
+    Sys_VmShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, 20);
+    assert(rc == 0);
+    rc = P3_VmFastSwap(FAST);
+    assert(rc == P1_SUCCESS);
+}
@@ -0,0 +1,81 @@
+/*
+ * test_fault_priority.c
+ * Fault priorities and aging. 1 low priority child that touches 1 page,
+ * 5 high priority children that touch 4 pages each, 24 frames, 2 pagers.
+ * The low child is spawned first but runs after the high children, so
+ * its fault is queued 6th, behind one fault from each of them. The high
+ * faults keep coming as they are served, and would starve it, until it
+ * has waited FAULT_AGE (8) dequeues: it is the 9th fault served. Each
+ * high child records the value of new after each of its faults, which
+ * is its position in the order faults were served, so every position
+ * but 9 is seen. The queue never holds enough faults to add a pager.
+ */
+
+#define HIGH 5
+#define PAGES 4         // # of pages
+#define FRAMES 24
+#define PAGERS 2        // # of pagers
+#define FAULTS (HIGH * PAGES + 1)
+#define LOW_SERVED 9    // FAULT_AGE dequeues, then the low fault
+
+#include "vmtest.h"
+
+static int seen[FAULTS + 1];
+
+static int
+High(void *arg)
+{
+    int     id = (int) arg;
+
+    for (int j = 0; j < PAGES; j++) {
+        WritePages(id, j, 1);
+        seen[P3_vmStats.new] = TRUE;
+    }
+    CheckPages(id, 0, PAGES);
+    Sys_Terminate(1);
+    return 0;
+}
+
+static int
+Low(void *arg)
+{
+    WritePages(0, 0, 1);
+    CheckPages(0, 0, 1);
+    Sys_Terminate(1);
+    return 0;
+}
+
+static int
+Main(void *arg)
+{
+    Spawn("Low", Low, NULL, PRIORITY + 1);
+    for (int i = 1; i <= HIGH; i++) {
+        Spawn(MakeName("High", i), High, (void *) i, PRIORITY);
+    }
+    Wait(HIGH + 1);
+    Sys_Terminate(1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    Debug("P4_Startup starting.\n");
+    Run(Main);
+    P3_PrintStats(&P3_vmStats);
+    for (int i = 1; i <= FAULTS; i++) {
+        TEST(seen[i], i != LOW_SERVED);
+    }
+    TEST(P3_vmStats.faults, FAULTS);
+    TEST(P3_vmStats.new, FAULTS);
+    TEST(P3_vmStats.spawned, 0);
+    PASSED();
+    Sys_VmShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, PAGES);
+    assert(rc == 0);
+}
@@ -0,0 +1,57 @@
+/*
+ * test_fault_queue.c
+ * Fault queue high-water mark. 12 children, 1 page each, 12 frames,
+ * 2 pagers.
+ * The children all start at once and run before the pagers, so all 12
+ * faults are queued before the first is served: maxQueue is 12. Pager 0
+ * takes a batch of 4 and leaves 8, enough to add the second pager to the
+ * pool. Who serves the rest depends on the scheduling, so stolen isn't
+ * checked.
+ */
+
+#define CHILDREN 12
+#define PAGES 1         // # of pages
+#define FRAMES CHILDREN
+#define PAGERS 2        // # of pagers
+
+#include "vmtest.h"
+
+static int
+Child(void *arg)
+{
+    int     id = (int) arg;
+
+    WritePages(id, 0, 1);
+    CheckPages(id, 0, 1);
+    Sys_Terminate(1);
+    return 0;
+}
+
+static int
+Main(void *arg)
+{
+    Together(CHILDREN, Child);
+    Sys_Terminate(1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    Debug("P4_Startup starting.\n");
+    Run(Main);
+    P3_PrintStats(&P3_vmStats);
+    TEST(P3_vmStats.maxQueue, CHILDREN);
+    TEST(P3_vmStats.faults, CHILDREN);
+    TEST(P3_vmStats.new, CHILDREN);
+    TEST(P3_vmStats.spawned, 1);
+    PASSED();
+    Sys_VmShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, CHILDREN);
+    assert(rc == 0);
+}
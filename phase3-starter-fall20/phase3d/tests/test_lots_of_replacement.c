@@ -236,7 +236,10 @@ P4_Startup(void *arg)
     assert(result == 0);
     TEST(P3_vmStats.faults, 32);
     TEST(P3_vmStats.pageIns, 16);
-    TEST(P3_vmStats.pageOuts, 19);
+    // every page is written back once, when the next child to run evicts it
+    TEST(P3_vmStats.pageOuts, 16);
+    // the pages read back are clean, unless their child quit and freed them first
+    TEST(P3_vmStats.cleanDrops <= 12, TRUE);
     PASSED();
     USLOSS_Console("Stats after all %d children which each did a read and a write to %d pages\n", CHILDREN, PAGES);
     Sys_VmShutdown();
@@ -1,7 +1,9 @@
 /*
- * 1 child, 21 pages, 1 frame.
+ * 1 child, 22 pages, 1 frame.
  * Create a disk with 10 tracks.  Force page outs
- * until there is no more space on the disk. Check that the process terminates.
+ * until there is no more space on the disk and in memory. Swap space is only
+ * used when a page is written out, so the frame holds one more page than the
+ * disk. Check that the process terminates.
  * Check deterministic statistics.
  */
 
@@ -17,7 +19,7 @@
 #include "tester.h"
 #include "phase3Int.h"
  
-#define PAGES		21
+#define PAGES		22
 #define CHILDREN 	1
 #define FRAMES 		1
 #define PRIORITY	1
@@ -70,12 +72,12 @@ Child(void *arg)
     USLOSS_Console("Stats before touching the pages:\n");
     P3_PrintStats(&P3_vmStats);
 
-    for (page = 0; page < numBlocks; page++) {
+    for (page = 0; page < numBlocks + FRAMES; page++) {
         sprintf(buffer, "Child wrote page %d\n", page);
         string = (char *) (vmRegion + (page * USLOSS_MmuPageSize()));
         strcpy(string, buffer);
     }
-    sprintf(buffer, "Child wrote %d pages\n", numBlocks);
+    sprintf(buffer, "Child wrote %d pages\n", numBlocks + FRAMES);
     USLOSS_Console("%s", buffer);
     P3_PrintStats(&P3_vmStats);
     USLOSS_Console("Let's touch one more page...\n");
@@ -108,7 +110,7 @@ int P4_Startup(void *arg)
 	blocksPerTrack = USLOSS_DISK_TRACK_SIZE / sectorsPerBlock;
 	numBlocks = (tracks ) * blocksPerTrack;
 	printf("Page size:%d, Sectors/block:%d, Blocks/track:%d, numBlocks:%d\n", USLOSS_MmuPageSize(),sectorsPerBlock,blocksPerTrack,numBlocks);
-	if (numBlocks < PAGES) {
+	if (numBlocks + FRAMES < PAGES) {
 		rc = Sys_Spawn("Child", Child, 0, USLOSS_MIN_STACK, PRIORITY, &pid);
 		assert(rc == P1_SUCCESS);
                 rc = Sys_Wait(&pid, &child);
@@ -0,0 +1,64 @@
+/*
+ * test_pager_pool.c
+ * Growing and shrinking the pager pool. 2 rounds of 8 children, 1 page
+ * each, 8 frames, 2 pagers.
+ * The children of a round all fault at once. Pager 0 takes 4 and, with 4
+ * still queued, forks pager 1, which steals the other 4. Between the
+ * rounds the pool is idle for a second, longer than PAGER_IDLE_TIME, so
+ * pager 1 retires. In the second round every fault goes to pager 0, which
+ * reaps the retired pager and forks it again.
+ * 2 spawned, 1 retired, 8 stolen, 16 faults.
+ */
+
+#define CHILDREN 8
+#define PAGES 1         // # of pages
+#define FRAMES CHILDREN
+#define PAGERS 2        // # of pagers
+
+#include "vmtest.h"
+
+static int
+Child(void *arg)
+{
+    int     id = (int) arg;
+
+    WritePages(id, 0, 1);
+    CheckPages(id, 0, 1);
+    Sys_Terminate(1);
+    return 0;
+}
+
+static int
+Main(void *arg)
+{
+    Together(CHILDREN, Child);
+    TEST(P3_vmStats.spawned, 1);
+    TEST(P3_vmStats.stolen, CHILDREN / 2);
+    Sys_Sleep(1);
+    TEST(P3_vmStats.retired, 1);
+    Together(CHILDREN, Child);
+    Sys_Terminate(1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    Debug("P4_Startup starting.\n");
+    Run(Main);
+    P3_PrintStats(&P3_vmStats);
+    TEST(P3_vmStats.spawned, 2);
+    TEST(P3_vmStats.retired, 1);
+    TEST(P3_vmStats.stolen, CHILDREN);
+    TEST(P3_vmStats.faults, 2 * CHILDREN);
+    TEST(P3_vmStats.new, 2 * CHILDREN);
+    PASSED();
+    Sys_VmShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, CHILDREN);
+    assert(rc == 0);
+}
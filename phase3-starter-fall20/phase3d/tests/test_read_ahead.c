@@ -0,0 +1,66 @@
+/*
+ * test_read_ahead.c
+ * Swap read-ahead. 8 Swappers with 2 pages each, 16 frames, 2 pagers,
+ * window of 1 page.
+ * The Swappers write their pages, then a hog evicts them one at a time,
+ * so each Swapper's pages go to the two slots of one track: 16 single
+ * writes. The hog's frames are free when the Swappers read their pages
+ * back, so a fault on page 0 reads page 1 along with it and page 1
+ * doesn't fault.
+ * 8 prefetched, 8 page-ins, 16 pageOuts, 24 diskOps, 40 faults.
+ */
+
+#define SWAPPERS 8
+#define PAGES 16        // # of pages
+#define FRAMES 16
+#define PAGERS 2        // # of pagers
+#define WINDOW 1        // # of pages read ahead
+
+#include "vmtest.h"
+
+static void
+WriteTwo(int id)
+{
+    WritePages(id, 0, 2);
+}
+
+static void
+CheckTwo(int id)
+{
+    CheckPages(id, 0, 2);
+}
+
+static int
+Main(void *arg)
+{
+    Write(SWAPPERS, WriteTwo, CheckTwo);
+    Evict();
+    Read();
+    Finish();
+    Sys_Terminate(1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    Debug("P4_Startup starting.\n");
+    Run(Main);
+    P3_PrintStats(&P3_vmStats);
+    TEST(P3_vmStats.prefetched, SWAPPERS);
+    TEST(P3_vmStats.pageIns, SWAPPERS);
+    TEST(P3_vmStats.pageOuts, 2 * SWAPPERS);
+    TEST(P3_vmStats.diskOps, 3 * SWAPPERS);
+    TEST(P3_vmStats.faults, 2 * SWAPPERS + FRAMES + SWAPPERS);
+    PASSED();
+    Sys_VmShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, 20);
+    assert(rc == 0);
+    rc = P3_VmReadAhead(WINDOW);
+    assert(rc == P1_SUCCESS);
+}
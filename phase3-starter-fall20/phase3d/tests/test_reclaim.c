@@ -0,0 +1,60 @@
+/*
+ * test_reclaim.c
+ * Reclaim daemon. 1 child, 4 pages, 4 frames, 2 pagers, watermarks of 1
+ * and 2 frames.
+ * The child writes all four pages. Taking the last free frame wakes the
+ * daemon, which runs while the child sleeps and writes out p0 and p1 in
+ * one clustered write to get back to 2 free frames. The child reads p0
+ * and p1 back, the fault on p1 takes the last free frame again and the
+ * daemon writes out p2 and p3. It sleeps again and reads p2 and p3 back,
+ * this time the daemon drops p0 and p1, which match their swap copies.
+ * 8 faults, 4 new, 4 page-ins, 4 pageOuts, 2 cleanDrops, 6 reclaimed.
+ */
+
+#define PAGES 4         // # of pages
+#define FRAMES PAGES
+#define PAGERS 2        // # of pagers
+#define LOW 1           // wake the reclaim daemon below this many free frames
+#define HIGH 2          // the daemon frees frames up to this many
+
+#include "vmtest.h"
+
+static int
+Main(void *arg)
+{
+    WritePages(0, 0, PAGES);
+    Sys_Sleep(1);
+    TEST(P3_vmStats.freeFrames, 2);
+    TEST(P3_vmStats.reclaimed, 2);
+    TEST(P3_vmStats.pageOuts, 2);
+    CheckPages(0, 0, 2);
+    Sys_Sleep(1);
+    CheckPages(0, 2, 2);
+    P3_PrintStats(&P3_vmStats);
+    Sys_Terminate(1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    Debug("P4_Startup starting.\n");
+    Run(Main);
+    TEST(P3_vmStats.faults, 8);
+    TEST(P3_vmStats.new, 4);
+    TEST(P3_vmStats.pageIns, 4);
+    TEST(P3_vmStats.pageOuts, 4);
+    TEST(P3_vmStats.cleanDrops, 2);
+    TEST(P3_vmStats.reclaimed, 6);
+    PASSED();
+    Sys_VmShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, PAGES);
+    assert(rc == 0);
+    rc = P3_VmWatermarks(LOW, HIGH);
+    assert(rc == P1_SUCCESS);
+}
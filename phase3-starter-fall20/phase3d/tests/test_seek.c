@@ -0,0 +1,93 @@
+/*
+ * test_seek.c
+ * Slot placement near the disk head. 1 process with 16 pages, then 8
+ * Swappers with 2 pages each, 16 frames, 2 pagers.
+ * The first process fills memory and waits. The Swappers write their
+ * pages one at a time, and each fault evicts its next page. They go to
+ * slots 0 to 15, one track after the other, so the head moves 7 tracks.
+ * The process quits, which frees all its slots, and the head is left on
+ * track 7. The hog then evicts the Swappers' pages. Each Swapper's first
+ * page goes on the free track nearest the head, and its second page goes
+ * right after it. So they fill tracks 7 down to 0, and the head moves 7
+ * more tracks: 14 in all before the Swappers read their pages back.
+ */
+
+#define SWAPPERS 8
+#define PAGES 16        // # of pages
+#define FRAMES 16
+#define PAGERS 2        // # of pagers
+
+#include "vmtest.h"
+
+static int  evicteeReady;
+static int  evicteeDone;
+
+static int
+Evictee(void *arg)
+{
+    int     rc;
+
+    WritePages(SWAPPERS, 0, PAGES);
+    rc = Sys_SemV(evicteeReady);
+    assert(rc == P1_SUCCESS);
+    rc = Sys_SemP(evicteeDone);
+    assert(rc == P1_SUCCESS);
+    Sys_Terminate(1);
+    return 0;
+}
+
+static void
+WriteTwo(int id)
+{
+    WritePages(id, 0, 2);
+}
+
+static void
+CheckTwo(int id)
+{
+    CheckPages(id, 0, 2);
+}
+
+static int
+Main(void *arg)
+{
+    int     rc;
+
+    rc = Sys_SemCreate("evicteeReady", 0, &evicteeReady);
+    assert(rc == P1_SUCCESS);
+    rc = Sys_SemCreate("evicteeDone", 0, &evicteeDone);
+    assert(rc == P1_SUCCESS);
+    Spawn("Evictee", Evictee, NULL, PRIORITY);
+    rc = Sys_SemP(evicteeReady);
+    assert(rc == P1_SUCCESS);
+    Write(SWAPPERS, WriteTwo, CheckTwo);
+    TEST(P3_vmStats.seekDistance, 7);
+    // the Swappers are waiting, so the one child to quit is the Evictee
+    rc = Sys_SemV(evicteeDone);
+    assert(rc == P1_SUCCESS);
+    Wait(1);
+    Evict();
+    TEST(P3_vmStats.seekDistance, 14);
+    Read();
+    Finish();
+    Sys_Terminate(1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    Debug("P4_Startup starting.\n");
+    Run(Main);
+    P3_PrintStats(&P3_vmStats);
+    TEST(P3_vmStats.pageOuts, PAGES + 2 * SWAPPERS);
+    PASSED();
+    Sys_VmShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, 20);
+    assert(rc == 0);
+}
@@ -0,0 +1,55 @@
+/*
+ * test_steal.c
+ * Work stealing. 8 children, 1 page each, 8 frames, 2 pagers.
+ * Only pager 0 is running when the children fault, so all 8 faults are
+ * queued for it. It takes a batch of 4 and forks pager 1, whose own queue
+ * is empty, so it steals the other 4 from pager 0's queue. Each pager
+ * serves one batch: 4 stolen, 2 wakeups, 8 faults.
+ */
+
+#define CHILDREN 8
+#define PAGES 1         // # of pages
+#define FRAMES CHILDREN
+#define PAGERS 2        // # of pagers
+
+#include "vmtest.h"
+
+static int
+Child(void *arg)
+{
+    int     id = (int) arg;
+
+    WritePages(id, 0, 1);
+    CheckPages(id, 0, 1);
+    Sys_Terminate(1);
+    return 0;
+}
+
+static int
+Main(void *arg)
+{
+    Together(CHILDREN, Child);
+    Sys_Terminate(1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    Debug("P4_Startup starting.\n");
+    Run(Main);
+    P3_PrintStats(&P3_vmStats);
+    TEST(P3_vmStats.stolen, CHILDREN / 2);
+    TEST(P3_vmStats.wakeups, 2);
+    TEST(P3_vmStats.spawned, 1);
+    TEST(P3_vmStats.faults, CHILDREN);
+    PASSED();
+    Sys_VmShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, CHILDREN);
+    assert(rc == 0);
+}
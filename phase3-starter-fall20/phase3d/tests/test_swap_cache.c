@@ -0,0 +1,66 @@
+/*
+ * test_swap_cache.c
+ * Compressed swap cache. 8 Swappers with 2 pages each, 16 frames,
+ * 2 pagers, a cache of half of memory.
+ * The Swappers write a short message on each page, the rest of the page
+ * is zeros, so each page packs into a few bytes and all 16 fit in the
+ * cache when the hog evicts them. Nothing is written to the disk, and
+ * every page read back comes from the cache.
+ * 16 cached, 16 cacheHits, 0 pageOuts, 0 diskOps, 48 faults.
+ */
+
+#define SWAPPERS 8
+#define PAGES 16        // # of pages
+#define FRAMES 16
+#define PAGERS 2        // # of pagers
+#define CACHE 50        // % of memory
+
+#include "vmtest.h"
+
+static void
+WriteTwo(int id)
+{
+    WritePages(id, 0, 2);
+}
+
+static void
+CheckTwo(int id)
+{
+    CheckPages(id, 0, 2);
+}
+
+static int
+Main(void *arg)
+{
+    Write(SWAPPERS, WriteTwo, CheckTwo);
+    Evict();
+    Read();
+    Finish();
+    Sys_Terminate(1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    Debug("P4_Startup starting.\n");
+    Run(Main);
+    P3_PrintStats(&P3_vmStats);
+    TEST(P3_vmStats.cached, 2 * SWAPPERS);
+    TEST(P3_vmStats.cacheHits, 2 * SWAPPERS);
+    TEST(P3_vmStats.pageIns, 2 * SWAPPERS);
+    TEST(P3_vmStats.pageOuts, 0);
+    TEST(P3_vmStats.diskOps, 0);
+    TEST(P3_vmStats.faults, 2 * SWAPPERS + FRAMES + 2 * SWAPPERS);
+    PASSED();
+    Sys_VmShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, 20);
+    assert(rc == 0);
+    rc = P3_VmSwapCache(CACHE);
+    assert(rc == P1_SUCCESS);
+}
@@ -0,0 +1,68 @@
+/*
+ * test_swap_disks.c
+ * Swap spread over two disk units. 8 Swappers with 2 pages each, 16
+ * frames, 2 pagers, units 0 and 1 with 4 tracks each.
+ * Each unit has 8 slots, so the 16 pages the hog evicts only fit if both
+ * units are used: the Swappers' pages go to the units in turn and every
+ * slot is taken. The Swappers then read their pages back from both units
+ * at once.
+ * 16 blocks, 0 free blocks after the eviction, 16 pageOuts, 16 page-ins.
+ */
+
+#define SWAPPERS 8
+#define PAGES 16        // # of pages
+#define FRAMES 16
+#define PAGERS 2        // # of pagers
+#define TRACKS 4        // # of tracks on each unit
+#define UNITS 3         // units 0 and 1
+
+#include "vmtest.h"
+
+static void
+WriteTwo(int id)
+{
+    WritePages(id, 0, 2);
+}
+
+static void
+CheckTwo(int id)
+{
+    CheckPages(id, 0, 2);
+}
+
+static int
+Main(void *arg)
+{
+    Write(SWAPPERS, WriteTwo, CheckTwo);
+    Evict();
+    TEST(P3_vmStats.blocks, 2 * SWAPPERS);
+    TEST(P3_vmStats.freeBlocks, 0);
+    Read();
+    Finish();
+    Sys_Terminate(1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    Debug("P4_Startup starting.\n");
+    Run(Main);
+    P3_PrintStats(&P3_vmStats);
+    TEST(P3_vmStats.pageOuts, 2 * SWAPPERS);
+    TEST(P3_vmStats.pageIns, 2 * SWAPPERS);
+    TEST(P3_vmStats.faults, 2 * SWAPPERS + FRAMES + 2 * SWAPPERS);
+    PASSED();
+    Sys_VmShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, 0, TRACKS);
+    assert(rc == 0);
+    rc = Disk_Create(NULL, 1, TRACKS);
+    assert(rc == 0);
+    rc = P3_VmSwapDisks(UNITS);
+    assert(rc == P1_SUCCESS);
+}
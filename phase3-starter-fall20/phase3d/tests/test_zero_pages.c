@@ -0,0 +1,65 @@
+/*
+ * test_zero_pages.c
+ * Zero pages. 8 Swappers with 2 pages each, 16 frames, 2 pagers.
+ * Each Swapper writes a message on page 0 and writes a zero on page 1,
+ * which leaves page 1 dirty but all zeros. When the hog evicts them the
+ * zero pages are dropped without a slot or a write, and read back as new
+ * pages.
+ * 8 zeroPages, 8 pageOuts, 8 page-ins, 40 new, 48 faults.
+ */
+
+#define SWAPPERS 8
+#define PAGES 16        // # of pages
+#define FRAMES 16
+#define PAGERS 2        // # of pagers
+
+#include "vmtest.h"
+
+static void
+WriteZero(int id)
+{
+    WritePages(id, 0, 1);
+    *Page(1) = '\0';
+}
+
+static void
+CheckZero(int id)
+{
+    CheckPages(id, 0, 1);
+    for (int i = 0; i < pageSize; i++) {
+        TEST(Page(1)[i], '\0');
+    }
+}
+
+static int
+Main(void *arg)
+{
+    Write(SWAPPERS, WriteZero, CheckZero);
+    Evict();
+    Read();
+    Finish();
+    Sys_Terminate(1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    Debug("P4_Startup starting.\n");
+    Run(Main);
+    P3_PrintStats(&P3_vmStats);
+    TEST(P3_vmStats.zeroPages, SWAPPERS);
+    TEST(P3_vmStats.pageOuts, SWAPPERS);
+    TEST(P3_vmStats.pageIns, SWAPPERS);
+    TEST(P3_vmStats.new, 2 * SWAPPERS + FRAMES + SWAPPERS);
+    TEST(P3_vmStats.faults, 2 * SWAPPERS + FRAMES + 2 * SWAPPERS);
+    PASSED();
+    Sys_VmShutdown();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, 20);
+    assert(rc == 0);
+}
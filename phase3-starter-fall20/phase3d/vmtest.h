@@ -0,0 +1,252 @@
+/*
+ * vmtest.h
+ * Helpers for the tests of the pager pool and the swap features. Define
+ * PAGES, FRAMES and PAGERS before including it.
+ *
+ * Everything runs under a priority 1 Main process. Children are spawned at
+ * priority 1 as well, so none of them runs until Main blocks, and the
+ * pagers (P3_PAGER_PRIORITY) don't run until every child has faulted.
+ *
+ * The Swapper steps drive the same set of children through eviction and
+ * page-in: Write spawns them one at a time and lets each write its pages,
+ * Evict runs a Hog that touches FRAMES pages and so pushes every child page
+ * out, Read lets all the children read their pages back at once, and Finish
+ * makes them quit.
+ */
+
+#ifndef _VMTEST_H_
+#define _VMTEST_H_
+
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <string.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PRIORITY 1
+
+static char *vmRegion;
+static int  pageSize;
+
+static int passed = FALSE;
+
+#ifdef DEBUG
+static int debugging = 1;
+#else
+static int debugging = 0;
+#endif /* DEBUG */
+
+static void
+Debug(char *fmt, ...)
+{
+    va_list ap;
+
+    if (debugging) {
+        va_start(ap, fmt);
+        USLOSS_VConsole(fmt, ap);
+    }
+}
+
+static char *
+Page(int page)
+{
+    return vmRegion + page * pageSize;
+}
+
+/*
+ * Writes "Process id, page n" on count pages starting at first.
+ */
+static void
+WritePages(int id, int first, int count)
+{
+    for (int j = first; j < first + count; j++) {
+        snprintf(Page(j), pageSize, "Process %d, page %d", id, j);
+    }
+}
+
+/*
+ * Checks the messages written by WritePages.
+ */
+static void
+CheckPages(int id, int first, int count)
+{
+    char    message[64];
+
+    for (int j = first; j < first + count; j++) {
+        snprintf(message, sizeof(message), "Process %d, page %d", id, j);
+        TEST(strcmp(Page(j), message), 0);
+    }
+}
+
+static int
+Spawn(char *name, int (*func)(void *), void *arg, int priority)
+{
+    int     pid;
+    int     rc;
+
+    rc = Sys_Spawn(name, func, arg, USLOSS_MIN_STACK * 4, priority, &pid);
+    assert(rc == P1_SUCCESS);
+    return pid;
+}
+
+/*
+ * Waits for count children to quit, each with status 1.
+ */
+static void
+Wait(int count)
+{
+    int     pid;
+    int     status;
+    int     rc;
+
+    for (int i = 0; i < count; i++) {
+        rc = Sys_Wait(&pid, &status);
+        assert(rc == P1_SUCCESS);
+        TEST(status, 1);
+    }
+}
+
+/*
+ * Starts the VM system and runs main at priority 1 until it quits.
+ */
+static void
+Run(int (*main)(void *))
+{
+    int     rc;
+
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion);
+    TEST(rc, P1_SUCCESS);
+    pageSize = USLOSS_MmuPageSize();
+    Spawn("Main", main, NULL, PRIORITY);
+    Wait(1);
+}
+
+/*
+ * Spawns count children that all start at once, child i gets i as its
+ * argument, and waits for them to quit.
+ */
+static void
+Together(int count, int (*child)(void *))
+{
+    for (int i = 0; i < count; i++) {
+        Spawn(MakeName("Child", i), child, (void *) i, PRIORITY);
+    }
+    Wait(count);
+}
+
+static int
+Hog(void *arg)
+{
+    WritePages(-1, 0, FRAMES);
+    Sys_Terminate(1);
+    return 0;
+}
+
+static int  swappers = 0;
+static int  ready = -1;
+static int  go = -1;
+static int  quitting = FALSE;
+static void (*swapWrite)(int id);
+static void (*swapRead)(int id);
+
+static int
+Swapper(void *arg)
+{
+    int     id = (int) arg;
+    int     rc;
+
+    Debug("Swapper %d starting.\n", id);
+    swapWrite(id);
+    rc = Sys_SemV(ready);
+    assert(rc == P1_SUCCESS);
+    while (TRUE) {
+        rc = Sys_SemP(go);
+        assert(rc == P1_SUCCESS);
+        if (quitting) {
+            break;
+        }
+        swapRead(id);
+        rc = Sys_SemV(ready);
+        assert(rc == P1_SUCCESS);
+    }
+    Sys_Terminate(1);
+    return 0;
+}
+
+/*
+ * Spawns count Swappers one at a time, each runs write(id) before the next
+ * one starts. read(id) is what they do at each Read.
+ */
+static void
+Write(int count, void (*write)(int id), void (*read)(int id))
+{
+    int     rc;
+
+    rc = Sys_SemCreate("ready", 0, &ready);
+    assert(rc == P1_SUCCESS);
+    rc = Sys_SemCreate("go", 0, &go);
+    assert(rc == P1_SUCCESS);
+    swapWrite = write;
+    swapRead = read;
+    for (swappers = 0; swappers < count; swappers++) {
+        Spawn(MakeName("Swapper", swappers), Swapper, (void *) swappers, PRIORITY);
+        rc = Sys_SemP(ready);
+        assert(rc == P1_SUCCESS);
+    }
+}
+
+/*
+ * Runs a Hog. Its pages are the most recently used, so it evicts every
+ * Swapper page in memory and none of its own.
+ */
+static void
+Evict(void)
+{
+    Spawn("Hog", Hog, NULL, PRIORITY);
+    Wait(1);
+}
+
+static void
+Read(void)
+{
+    int     rc;
+
+    for (int i = 0; i < swappers; i++) {
+        rc = Sys_SemV(go);
+        assert(rc == P1_SUCCESS);
+    }
+    for (int i = 0; i < swappers; i++) {
+        rc = Sys_SemP(ready);
+        assert(rc == P1_SUCCESS);
+    }
+}
+
+static void
+Finish(void)
+{
+    int     rc;
+
+    quitting = TRUE;
+    for (int i = 0; i < swappers; i++) {
+        rc = Sys_SemV(go);
+        assert(rc == P1_SUCCESS);
+    }
+    Wait(swappers);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
+
+#endif /* _VMTEST_H_ */